@@ -0,0 +1,418 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include<bits/stdc++.h>
+#include"../src/simulator.h"
+using namespace std;
+
+//micro-benchmarks for the simulator's data structures, built separately from the simulator
+//each benchmark prints one table; times are wall clock from steady_clock
+
+static double elapsed_ms(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+//mempool of num_txs one-input transactions spending fresh genesis outputs
+static void bench_fill_mempool(Mempool& mempool, UTXOManager& utxo_manager, int num_txs, const string& tag)
+{
+    for(int i = 0; i < num_txs; ++i)
+    {
+        string owner = tag + "_owner" + to_string(i);
+        utxo_manager.add_utxo(tag + "_genesis", i, 10.0, owner);
+        Transaction tx;
+        tx.tx_id = tag + "_tx" + to_string(i);
+        tx.inputs.push_back({tag + "_genesis", i, owner, string(64, 's')});
+        tx.outputs.push_back({10.0 - 0.001 * (1 + i % 50), "Recipient" + to_string(i % 97)});
+        tx.outputs.push_back({0.0005, owner});
+        mempool.add_transaction(tx, utxo_manager);
+    }
+}
+
+//compact blocks vs full blocks: bytes on the wire and time to obtain the block on the receiver
+//the receiver's mempool lacks missing_fraction of the block, which a full block would not need
+static void bench_compact_blocks(int block_txs = 2000, double missing_fraction = 0.02)
+{
+    cout << "\n--- Compact Blocks (" << block_txs << " txs, " << missing_fraction * 100 << "% missing) ---" << endl;
+    UTXOManager utxo_manager;
+    Mempool sender(block_txs + 1), receiver(block_txs + 1);
+    bench_fill_mempool(sender, utxo_manager, block_txs, "cb");
+
+    Block block = {1, "BenchMiner", sender.get_top_transactions(block_txs), 0, 6.25, "Thu Jan  1 00:00:00 2026"};
+    unordered_set<string> peer_has;
+    int stride = missing_fraction > 0 ? max(1, (int)(1 / missing_fraction)) : 0;
+    for(size_t i = 0; i < block.transactions.size(); ++i)
+    {
+        const Transaction& tx = block.transactions[i];
+        block.total_fees += tx.fee;
+        if(i % 10 == 9)
+            continue; // never relayed: prefilled
+        peer_has.insert(tx.tx_id);
+        if(stride && i % stride == 0)
+            continue; // relayed but dropped by the receiver: requested
+        receiver.add_transaction(tx, utxo_manager);
+    }
+
+    auto start = chrono::steady_clock::now();
+    Block full_copy = block;
+    double full_ms = elapsed_ms(start);
+
+    start = chrono::steady_clock::now();
+    CompactBlock cb = make_compact_block(block, peer_has, 0x5eed);
+    double encode_ms = elapsed_ms(start);
+
+    start = chrono::steady_clock::now();
+    CompactReconstruction r = reconstruct_block(cb, receiver);
+    double rebuild_ms = elapsed_ms(start);
+    size_t requested = r.missing.size();
+    vector<Transaction> reply;
+    for(int pos : r.missing)
+        reply.push_back(block.transactions[pos]);
+    size_t reply_bytes = 0;
+    for(const auto& tx : reply)
+        reply_bytes += tx_size(tx);
+    start = chrono::steady_clock::now();
+    bool ok = fill_missing(r, cb, reply);
+    rebuild_ms += elapsed_ms(start);
+    for(size_t i = 0; ok && i < block.transactions.size(); ++i)
+        ok = r.block.transactions[i].tx_id == block.transactions[i].tx_id;
+
+    size_t full_bytes = block_size(full_copy);
+    size_t compact_bytes = compact_block_size(cb);
+    cout << left << setw(28) << "Full block bytes" << full_bytes << endl;
+    cout << left << setw(28) << "Compact block bytes" << compact_bytes << " ("
+         << fixed << setprecision(1) << 100.0 * compact_bytes / full_bytes << "%)" << endl;
+    cout << left << setw(28) << "Prefilled / requested" << cb.prefilled.size() << " / " << requested
+         << " (+" << reply_bytes << " bytes)" << endl;
+    cout << left << setw(28) << "Full block copy" << setprecision(3) << full_ms << " ms" << endl;
+    cout << left << setw(28) << "Compact encode" << encode_ms << " ms" << endl;
+    cout << left << setw(28) << "Compact reconstruct" << rebuild_ms << " ms" << endl;
+    cout << left << setw(28) << "Reconstructed correctly" << (ok ? "yes" : "NO") << endl;
+    cout << defaultfloat;
+}
+
+//disk-backed UTXO set under a chain of blocks that each spend older outputs and create new ones
+//a block's change output is spent again in the same block, so it never reaches the disk
+static void bench_utxo_store(int num_blocks = 200, int txs_per_block = 500, size_t cache_capacity = 20000)
+{
+    cout << "\n--- Disk UTXO Store (" << num_blocks << " blocks x " << txs_per_block << " txs, cache " << cache_capacity << ") ---" << endl;
+    const string path = "bench_utxo_store";
+    remove((path + ".idx").c_str());
+    remove((path + ".dat").c_str());
+    UTXODiskStore store;
+    store.open(path);
+    UTXOCache cache(store, cache_capacity);
+    map<pair<string, int>, double> reference;
+    mt19937_64 rng(7);
+
+    vector<pair<string, int>> spendable;
+    for(int i = 0; i < txs_per_block; ++i)
+    {
+        cache.add_utxo("genesis", i, 100.0, "Owner" + to_string(i));
+        reference[{"genesis", i}] = 100.0;
+        spendable.push_back({"genesis", i});
+    }
+    cache.flush();
+
+    auto start = chrono::steady_clock::now();
+    bool ok = true;
+    for(int h = 1; h <= num_blocks && ok; ++h)
+    {
+        Block block = {h, "BenchMiner", {}, 0, 6.25, ""};
+        for(int t = 0; t < txs_per_block; ++t)
+        {
+            size_t pick = rng() % spendable.size();
+            auto outpoint = spendable[pick];
+            spendable[pick] = spendable.back();
+            spendable.pop_back();
+            double amount = reference[outpoint];
+            reference.erase(outpoint);
+
+            Transaction tx, sweep;
+            tx.tx_id = "b" + to_string(h) + "_t" + to_string(t);
+            tx.inputs.push_back({outpoint.first, outpoint.second, "Owner"});
+            tx.outputs.push_back({amount / 2, "Owner"});
+            tx.outputs.push_back({amount / 2, "Owner"});
+            sweep.tx_id = tx.tx_id + "_s";
+            sweep.inputs.push_back({tx.tx_id, 1, "Owner"});
+            sweep.outputs.push_back({amount / 2, "Owner"});
+            block.transactions.push_back(tx);
+            block.transactions.push_back(sweep);
+            reference[{tx.tx_id, 0}] = amount / 2;
+            reference[{sweep.tx_id, 0}] = amount / 2;
+            spendable.push_back({tx.tx_id, 0});
+            spendable.push_back({sweep.tx_id, 0});
+        }
+        reference[{coinbase_tx_id(h), 0}] = 6.25;
+        ok = connect_block(block, cache).first;
+    }
+    double connect_ms = elapsed_ms(start);
+
+    size_t on_disk = 0;
+    store.for_each([&](const UTXO& u) {
+        auto it = reference.find({u.tx_id, u.index});
+        ok = ok && it != reference.end() && fabs(it->second - u.amount) < 1e-9;
+        on_disk++;
+    });
+    ok = ok && on_disk == reference.size();
+
+    UTXOCacheStats st = cache.stats();
+    cout << left << setw(28) << "Connect + flush" << fixed << setprecision(3) << connect_ms << " ms ("
+         << connect_ms / num_blocks << " ms/block)" << endl;
+    cout << left << setw(28) << "Cache hits / misses" << st.hits << " / " << st.misses << endl;
+    cout << left << setw(28) << "Written / erased" << st.written << " / " << st.erased << endl;
+    cout << left << setw(28) << "Never written" << st.fresh_spends << endl;
+    cout << left << setw(28) << "UTXOs on disk" << store.size() << endl;
+    cout << left << setw(28) << "Matches in-memory set" << (ok ? "yes" : "NO") << endl;
+    cout << defaultfloat;
+    store.close();
+    remove((path + ".idx").c_str());
+    remove((path + ".dat").c_str());
+}
+
+//serial connect_block on the std::map UTXOManager vs parallel_connect_block on the sharded set
+//the block mixes independent spends with chains of chain_length dependent transactions
+static void bench_parallel_connect(int block_txs = 20000, int chain_length = 4, int utxo_set_size = 200000)
+{
+    cout << "\n--- Parallel Block Connect (" << block_txs << " txs, chains of " << chain_length << ", "
+         << utxo_set_size << " UTXOs) ---" << endl;
+    UTXOManager base;
+    for(int i = 0; i < utxo_set_size; ++i)
+        base.add_utxo("genesis", i, 10.0, "Owner" + to_string(i % 1000));
+    Block block = {1, "BenchMiner", {}, 0, 6.25, ""};
+    for(int i = 0, source = 0; i < block_txs; ++source)
+    {
+        string prev = "genesis";
+        int prev_index = source;
+        for(int c = 0; c < chain_length && i < block_txs; ++c, ++i)
+        {
+            Transaction tx;
+            tx.tx_id = "par_" + to_string(i);
+            tx.inputs.push_back({prev, prev_index, "Owner"});
+            tx.outputs.push_back({5.0, "Owner"});
+            tx.outputs.push_back({4.9, "Shop" + to_string(i % 50)});
+            tx.fee = 0.1;
+            block.total_fees += tx.fee;
+            block.transactions.push_back(tx);
+            prev = tx.tx_id;
+            prev_index = 0;
+        }
+    }
+
+    UTXOManager serial = base;
+    BlockUndo undo;
+    auto start = chrono::steady_clock::now();
+    connect_block(block, serial, undo);
+    double serial_ms = elapsed_ms(start);
+    cout << left << setw(28) << "Serial connect_block" << fixed << setprecision(3) << serial_ms << " ms" << endl;
+
+    int hw = max(1u, thread::hardware_concurrency());
+    for(int threads = 1; threads <= max(8, hw); threads *= 2)
+    {
+        ConcurrentUTXOSet shared(base);
+        ParallelConnectStats stats;
+        start = chrono::steady_clock::now();
+        bool ok = parallel_connect_block(block, shared, threads, &stats).first;
+        double ms = elapsed_ms(start);
+        ok = ok && shared.state_hash() == serial.state_hash();
+        cout << left << setw(28) << ("Parallel, " + to_string(threads) + " threads") << ms << " ms (x"
+             << setprecision(2) << serial_ms / ms << setprecision(3) << ", " << stats.groups << " groups)"
+             << (ok ? "" : " MISMATCH") << endl;
+    }
+    cout << "(hardware threads: " << hw << ")" << endl;
+    cout << defaultfloat;
+}
+
+//one policy configuration: admit num_txs transactions of mixed sizes and fees, mine them in
+//blocks of 1000, then drive a full simulator of the same policies through a payment workload
+template<typename Fee, typename Selection, typename Halving, typename Storage, int BlockTxs>
+static void bench_policy(const string& name, int num_txs)
+{
+    BasicUTXOManager<Storage> utxos;
+    BasicMempool<Selection, Fee> mempool(num_txs + 1, 0.001);
+    vector<Transaction> txs;
+    for(int i = 0; i < num_txs; ++i)
+    {
+        string owner = "Owner" + to_string(i % 1000);
+        utxos.add_utxo("policy_genesis", i, 10.0, owner);
+        Transaction tx;
+        tx.tx_id = "policy_tx" + to_string(i);
+        tx.inputs.push_back({"policy_genesis", i, owner, string(64, 's')});
+        tx.outputs.push_back({10.0 - 0.002 - 0.0001 * (i % 37), "Shop" + to_string(i % 97)});
+        for(int extra = i % 3; extra > 0; --extra)
+            tx.outputs.push_back({0, owner}); //varies the size, so fee and fee rate orders differ
+        txs.push_back(move(tx));
+    }
+
+    streambuf* saved = cout.rdbuf(nullptr);
+    auto start = chrono::steady_clock::now();
+    for(auto& tx : txs)
+        mempool.add_transaction(move(tx), utxos);
+    double admit_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    int height = 0;
+    while(!mempool.transactions.empty())
+        mine_block("BenchMiner", mempool, utxos, ++height, 6.25, 1000);
+    double mine_ms = elapsed_ms(start);
+
+    start = chrono::steady_clock::now();
+    BasicSimulator<Fee, Selection, Halving, Storage, BlockTxs> sim(0.01, 6.25, 1000, 2, 1 << 20, 3600, 1);
+    const char* owners[] = {"Alice", "Bob", "Charlie", "David", "Eve"};
+    for(int round = 0; round < 20; ++round)
+    {
+        for(int o = 0; o < 5; ++o)
+            sim.create_transaction(owners[o], owners[(o + round + 1) % 5], 0.5);
+        sim.mine_next_block(owners[round % 5]);
+    }
+    double sim_ms = elapsed_ms(start);
+    cout.rdbuf(saved);
+    cout.clear();
+
+    cout << left << setw(44) << name << fixed << setprecision(3) << setw(14) << admit_ms << setw(14) << mine_ms << sim_ms << endl;
+    cout << defaultfloat;
+}
+
+//the same workload under several policy instantiations side by side
+static void bench_policies(int num_txs = 20000)
+{
+    cout << "\n--- Policy Instantiations (" << num_txs << " txs; simulator: 20 blocks x 5 signed payments) ---" << endl;
+    cout << left << setw(44) << "Fee / Selection / Halving / Storage / Block" << setw(14) << "Admit ms" << setw(14) << "Mine ms" << "Simulator ms" << endl;
+    bench_policy<PercentageFee, SelectByFee, HalveEveryK, OrderedUTXOMap, 4>("Percentage / Fee / EveryK / Ordered / 4", num_txs);
+    bench_policy<PercentageFee, SelectByFeeRate, HalveEveryK, OrderedUTXOMap, 4>("Percentage / FeeRate / EveryK / Ordered / 4", num_txs);
+    bench_policy<PercentageFee, SelectByFee, HalveEvery<210000>, HashedUTXOMap, 4>("Percentage / Fee / 210000 / Hashed / 4", num_txs);
+    bench_policy<FlatFee, SelectByFeeRate, NeverHalve, HashedUTXOMap, 1000>("Flat / FeeRate / Never / Hashed / 1000", num_txs);
+}
+
+//top-10 holders and total supply from the incrementally kept rich list, against a scan of
+//the whole UTXO set; also the cost the rich list adds to add_utxo/remove_utxo
+static void bench_rich_list(int utxo_set_size = 200000, int owners = 20000, int queries = 100)
+{
+    cout << "\n--- Rich List (" << utxo_set_size << " UTXOs, " << owners << " owners, " << queries << " queries) ---" << endl;
+    UTXOManager utxos;
+    auto start = chrono::steady_clock::now();
+    for(int i = 0; i < utxo_set_size; ++i)
+        utxos.add_utxo("rich", i, (i * 7919 % 10000) / 100.0, "Owner" + to_string(i % owners));
+    for(int i = 0; i < utxo_set_size; i += 2)
+        utxos.remove_utxo("rich", i);
+    double update_ms = elapsed_ms(start);
+
+    start = chrono::steady_clock::now();
+    double checksum = 0;
+    for(int q = 0; q < queries; ++q)
+    {
+        unordered_map<string, double> balances;
+        double supply = 0;
+        for(const auto& u : utxos.utxo_set)
+        {
+            balances[u.second.owner] += u.second.amount;
+            supply += u.second.amount;
+        }
+        vector<pair<double, string>> ranked;
+        for(const auto& b : balances)
+            ranked.push_back({-b.second, b.first});
+        partial_sort(ranked.begin(), ranked.begin() + min<size_t>(10, ranked.size()), ranked.end());
+        checksum += supply - ranked[0].first;
+    }
+    double scan_ms = elapsed_ms(start);
+
+    start = chrono::steady_clock::now();
+    for(int q = 0; q < queries; ++q)
+        checksum -= utxos.rich_list.total_supply() + utxos.rich_list.top(10)[0].second;
+    double indexed_ms = elapsed_ms(start);
+
+    cout << left << setw(28) << "Adds + removes" << fixed << setprecision(3) << update_ms << " ms" << endl;
+    cout << left << setw(28) << "Top-10 + supply, scan" << scan_ms << " ms" << endl;
+    cout << left << setw(28) << "Top-10 + supply, indexed" << indexed_ms << " ms (x" << setprecision(0) << scan_ms / max(indexed_ms, 1e-6)
+         << ")" << (fabs(checksum) < 1e-3 * queries ? "" : " MISMATCH") << endl;
+    cout << defaultfloat;
+}
+
+//the old per-line displays (ostringstream lines, setw, endl) against the buffered views,
+//all written to /dev/null through cout
+static void bench_views(int num_blocks = 2000, int block_txs = 20, int utxo_set_size = 200000)
+{
+    cout << "\n--- Chain and UTXO Views (" << num_blocks << " blocks x " << block_txs << " txs, " << utxo_set_size << " UTXOs) ---" << endl;
+    vector<Block> chain;
+    for(int h = 1; h <= num_blocks; ++h)
+    {
+        Block block = {h, "Miner" + to_string(h % 7), {}, 0, 6.25, "Thu Jan  1 00:00:00 2026"};
+        for(int i = 0; i < block_txs; ++i)
+        {
+            Transaction tx;
+            tx.tx_id = "view_" + to_string(h) + "_" + to_string(i);
+            tx.inputs.push_back({"prev", i, "Owner"});
+            tx.outputs.push_back({1.0, "Shop"});
+            tx.fee = 0.001;
+            block.transactions.push_back(tx);
+        }
+        chain.push_back(block);
+    }
+    UTXOManager utxos;
+    for(int i = 0; i < utxo_set_size; ++i)
+        utxos.add_utxo("view", i, i % 1000 / 10.0, "Owner" + to_string(i % 1000));
+
+    ofstream null("/dev/null");
+    streambuf* saved = cout.rdbuf(null.rdbuf());
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < chain.size(); ++i)
+    {
+        int box_width = chain[i].display();
+        if(i + 1 < chain.size())
+        {
+            int center_pos = box_width / 2 - 3;
+            cout << endl;
+            cout << "  " << string(center_pos - 1, ' ') << "|" << endl;
+            cout << "  " << string(center_pos - 1, ' ') << "v" << endl;
+        }
+    }
+    double old_chain_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    utxos.display();
+    double old_utxo_ms = elapsed_ms(start);
+
+    ViewRenderer renderer;
+    start = chrono::steady_clock::now();
+    renderer.render_blocks(chain, ViewRange(), RENDER_TEXT, cout);
+    double chain_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    renderer.render_blocks(chain, ViewRange(), RENDER_JSON, cout);
+    double chain_json_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    renderer.render_utxos(utxos, ViewRange(), RENDER_TEXT, cout);
+    double utxo_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    renderer.render_utxos(utxos, ViewRange(), RENDER_JSON, cout);
+    double utxo_json_ms = elapsed_ms(start);
+    size_t writes = renderer.writes;
+    start = chrono::steady_clock::now();
+    ViewRange page;
+    page.offset = num_blocks / 2;
+    page.limit = 20;
+    renderer.render_blocks(chain, page, RENDER_TEXT, cout);
+    double page_ms = elapsed_ms(start);
+    cout.rdbuf(saved);
+
+    cout << left << setw(28) << "Chain, display()" << fixed << setprecision(3) << old_chain_ms << " ms" << endl;
+    cout << left << setw(28) << "Chain, text view" << chain_ms << " ms (x" << setprecision(1) << old_chain_ms / chain_ms << setprecision(3) << ")" << endl;
+    cout << left << setw(28) << "Chain, JSON lines" << chain_json_ms << " ms" << endl;
+    cout << left << setw(28) << "Chain, one 20-block page" << page_ms << " ms" << endl;
+    cout << left << setw(28) << "UTXOs, display()" << old_utxo_ms << " ms" << endl;
+    cout << left << setw(28) << "UTXOs, text view" << utxo_ms << " ms (x" << setprecision(1) << old_utxo_ms / utxo_ms << setprecision(3) << ")" << endl;
+    cout << left << setw(28) << "UTXOs, JSON lines" << utxo_json_ms << " ms" << endl;
+    cout << "(" << writes << " stream writes for the four full views)" << endl;
+    cout << defaultfloat;
+}
+
+static void run_benchmarks()
+{
+    bench_compact_blocks(2000, 0.02);
+    bench_compact_blocks(20000, 0.0);
+    bench_utxo_store(200, 500, 20000);
+    bench_utxo_store(200, 500, 1000);
+    bench_parallel_connect(20000, 4, 200000);
+    bench_policies(20000);
+    bench_rich_list(200000, 20000, 100);
+    bench_views(2000, 20, 200000);
+}
+
+#endif
@@ -1,7 +1,35 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
 #include<bits/stdc++.h>
 #include"mempool.h"
 using namespace std;
 
+// Merkle root over transaction_digest() of each transaction, odd levels repeat their last node
+crypto::SetHash compute_merkle_root(const vector<Transaction>& transactions) {
+    crypto::SetHash zero = crypto::SetHash();
+    if (transactions.empty()) return zero;
+    vector<crypto::SetHash> level;
+    for (const auto& tx : transactions) {
+        crypto::Digest d = transaction_digest(tx);
+        crypto::SetHash leaf;
+        memcpy(leaf.data(), d.data(), 32);
+        level.push_back(leaf);
+    }
+    while (level.size() > 1) {
+        if (level.size() % 2) level.push_back(level.back());
+        vector<crypto::SetHash> next;
+        for (size_t i = 0; i < level.size(); i += 2) {
+            crypto::Digest d = crypto::Sha512().update(level[i].data(), 32).update(level[i + 1].data(), 32).final();
+            crypto::SetHash node;
+            memcpy(node.data(), d.data(), 32);
+            next.push_back(node);
+        }
+        level.swap(next);
+    }
+    return level[0];
+}
+
 struct Block {
     int block_height;
     string miner;
@@ -9,14 +37,49 @@ struct Block {
     double total_fees;
     double block_reward;
     string timestamp;
+    crypto::SetHash utxo_hash; // UTXO set commitment after this block, all zero if not recorded
+    crypto::SetHash merkle_root; // all zero if not recorded
+    int64_t time; // unix seconds, 0 if unknown
+    int tx_count; // number of transactions once pruned
+    bool pruned; // body dropped, only the summary fields above remain
+
+    bool has_utxo_hash() const {
+        return utxo_hash != crypto::SetHash();
+    }
+
+    bool has_merkle_root() const {
+        return merkle_root != crypto::SetHash();
+    }
+
+    int num_transactions() const {
+        return pruned ? tx_count : (int)transactions.size();
+    }
+
+    // drops the transaction bodies and the text timestamp, keeping height, miner, fees,
+    // reward, integer time, tx count, Merkle root and UTXO hash
+    void prune() {
+        if (pruned) return;
+        tx_count = transactions.size();
+        if (!has_merkle_root()) merkle_root = compute_merkle_root(transactions);
+        vector<Transaction>().swap(transactions);
+        string().swap(timestamp);
+        pruned = true;
+    }
 
     // Prints the block as an ASCII box and returns the total printed box width
     int display() {
         vector<string> lines;
         // Header line
         lines.push_back("Block #" + to_string(block_height) + " | Miner: " + miner);
-        // Time
-        lines.push_back(string("Time: ") + timestamp);
+        // Time, rebuilt from the integer time once the text is pruned
+        if (timestamp.empty() && time) {
+            time_t t = (time_t)time;
+            string text = ctime(&t);
+            if (!text.empty() && text.back() == '\n') text.pop_back();
+            lines.push_back("Time: " + text);
+        } else {
+            lines.push_back(string("Time: ") + timestamp);
+        }
         // Reward and fees line (formatted)
         {
             ostringstream oss;
@@ -24,7 +87,11 @@ struct Block {
             lines.push_back(oss.str());
         }
         // TX count
-        lines.push_back(string("TXs: ") + to_string(transactions.size()));
+        lines.push_back(string("TXs: ") + to_string(num_transactions()) + (pruned ? " (pruned)" : ""));
+        if (has_merkle_root())
+            lines.push_back("Merkle root: " + crypto::to_hex(merkle_root.data(), 8) + "...");
+        if (has_utxo_hash())
+            lines.push_back("UTXO hash: " + crypto::to_hex(utxo_hash.data(), 8) + "...");
         // Transactions
         for (const auto& tx : transactions) {
             ostringstream oss;
@@ -51,8 +118,132 @@ struct Block {
     }
 };
 
-Block mine_block(string miner_address, Mempool& mempool, UTXOManager& utxo_manager, int block_height, double block_reward, int num_txs = 4) {
-    vector<Transaction> to_mine = mempool.get_top_transactions(num_txs);
+//undo data for one connected block, kept as a net diff: utxos that existed before the
+//block and were spent, and outpoints that exist after it. Outputs created and spent
+//inside the same block appear in neither list.
+struct BlockUndo {
+    vector<UTXO> spent;
+    vector<pair<string, int>> created;
+};
+
+// builds a BlockUndo while a block is applied
+struct UndoBuilder {
+    BlockUndo& undo;
+    map<pair<string, int>, size_t> created_pos;
+
+    UndoBuilder(BlockUndo& undo) : undo(undo) {
+        undo = BlockUndo();
+    }
+
+    void spend(const UTXO& utxo) {
+        auto it = created_pos.find({utxo.tx_id, utxo.index});
+        if (it != created_pos.end()) {
+            undo.created[it->second].second = -1; // created and spent in this block
+            created_pos.erase(it);
+            return;
+        }
+        undo.spent.push_back(utxo);
+    }
+
+    void create(const string& tx_id, int index) {
+        created_pos[{tx_id, index}] = undo.created.size();
+        undo.created.push_back({tx_id, index});
+    }
+
+    void finish() {
+        undo.created.erase(remove_if(undo.created.begin(), undo.created.end(),
+            [](const pair<string, int>& o) { return o.second < 0; }), undo.created.end());
+    }
+};
+
+string coinbase_tx_id(int block_height) {
+    return "coinbase_block_" + to_string(block_height);
+}
+
+// rolls a block back: drop what it created, restore what it spent
+template<typename UTXOSet>
+void disconnect_block(const BlockUndo& undo, UTXOSet& utxo_manager) {
+    for (auto it = undo.created.rbegin(); it != undo.created.rend(); ++it) {
+        utxo_manager.remove_utxo(it->first, it->second);
+    }
+    for (auto it = undo.spent.rbegin(); it != undo.spent.rend(); ++it) {
+        utxo_manager.add_utxo(it->tx_id, it->index, it->amount, it->owner);
+    }
+}
+
+// applies a block to the UTXO set, every input must exist when its transaction is reached
+// with a verifier, signatures are checked too (cached ones are not verified again)
+// a recorded Merkle root must match the transactions and a recorded utxo_hash the resulting set
+// on failure the partial application is rolled back and the set is unchanged
+template<typename UTXOSet>
+pair<bool, string> connect_block(const Block& block, UTXOSet& utxo_manager, BlockUndo& undo, SignatureVerifier* verifier = nullptr) {
+    if (block.pruned)
+        return {false, "Block " + to_string(block.block_height) + " is pruned"};
+    if (block.has_merkle_root() && compute_merkle_root(block.transactions) != block.merkle_root)
+        return {false, "Block " + to_string(block.block_height) + ": Merkle root mismatch"};
+    UndoBuilder builder(undo);
+    for (const auto& tx : block.transactions) {
+        if (verifier) {
+            auto sig_check = verifier->check_transaction(tx, utxo_manager);
+            if (!sig_check.first) {
+                builder.finish();
+                disconnect_block(undo, utxo_manager);
+                undo = BlockUndo();
+                return {false, "Block " + to_string(block.block_height) + ": " + tx.tx_id + ": " + sig_check.second};
+            }
+        }
+        for (const auto& input : tx.inputs) {
+            const UTXO* spent = utxo_manager.find_utxo(input.prev_tx_id, input.index);
+            if (!spent) {
+                builder.finish();
+                disconnect_block(undo, utxo_manager);
+                undo = BlockUndo();
+                return {false, "Block " + to_string(block.block_height) + ": input UTXO does not exist: " + input.prev_tx_id + ":" + to_string(input.index)};
+            }
+            builder.spend(*spent);
+            utxo_manager.remove_utxo(input.prev_tx_id, input.index);
+        }
+        for (size_t i = 0; i < tx.outputs.size(); ++i) {
+            utxo_manager.add_utxo(tx.tx_id, i, tx.outputs[i].amount, tx.outputs[i].address);
+            builder.create(tx.tx_id, i);
+        }
+    }
+    string coinbase = coinbase_tx_id(block.block_height);
+    utxo_manager.add_utxo(coinbase, 0, block.block_reward + block.total_fees, block.miner);
+    builder.create(coinbase, 0);
+    builder.finish();
+    if (block.has_utxo_hash() && utxo_manager.state_hash() != block.utxo_hash) {
+        disconnect_block(undo, utxo_manager);
+        undo = BlockUndo();
+        return {false, "Block " + to_string(block.block_height) + ": UTXO set hash mismatch"};
+    }
+    return {true, "Block " + to_string(block.block_height) + " connected"};
+}
+
+// the selected transactions are moved out of the mempool into the block, in the order of
+// the mempool's selection policy
+template<typename MempoolType, typename UTXOSet>
+Block mine_block(const string& miner_address, MempoolType& mempool, UTXOSet& utxo_manager, int block_height, double block_reward, int num_txs = 4, BlockUndo* undo = nullptr) {
+    if(mempool.verifier)
+    {
+        // signatures were verified at admission, so these are cache hits; a transaction that
+        // no longer checks out (e.g. its owner's key changed) is evicted through the mempool,
+        // which tells the fee estimator, and the next best one is considered instead
+        vector<string> failed;
+        do {
+            failed.clear();
+            for(const Transaction* tx : mempool.top_entries(num_txs)) {
+                auto check = mempool.verifier->check_transaction(*tx, utxo_manager);
+                if(!check.first) {
+                    cout << "Transaction " << tx->tx_id << " failed verification: " << check.second << endl;
+                    failed.push_back(tx->tx_id);
+                }
+            }
+            for(const auto& id : failed)
+                mempool.evict(id);
+        } while(!failed.empty());
+    }
+    vector<Transaction> to_mine = mempool.take_top_transactions(num_txs);
     if(to_mine.empty()) 
     {
         cout << "No transactions to mine." << endl;
@@ -62,38 +253,66 @@ Block mine_block(string miner_address, Mempool& mempool, UTXOManager& utxo_manag
     cout << "Mining block..." << endl;
     cout << "Selected " << to_mine.size() << " transactions from mempool." << endl;
 
+    BlockUndo scratch;
+    UndoBuilder builder(undo ? *undo : scratch);
     double total_fees = 0;
     for(const auto& tx : to_mine) 
     {
         // remove spent input utxos from UTXO set
         for(const auto& input : tx.inputs) 
         {
+            if(const UTXO* spent = utxo_manager.find_utxo(input.prev_tx_id, input.index))
+                builder.spend(*spent);
             utxo_manager.remove_utxo(input.prev_tx_id, input.index);
         }
         // add output utxos to UTXO set
         for(size_t i = 0; i < tx.outputs.size(); ++i) 
         {
             utxo_manager.add_utxo(tx.tx_id, i, tx.outputs[i].amount, tx.outputs[i].address);
+            builder.create(tx.tx_id, i);
         }
         total_fees += tx.fee;
-        // remove from mempool
-        mempool.remove_transaction(tx.tx_id);
     }
 
     // block reward + total fees
     double total_miner_reward = block_reward + total_fees;
-    string coinbase_tx_id = "coinbase_block_" + to_string(block_height);
-    utxo_manager.add_utxo(coinbase_tx_id, 0, total_miner_reward, miner_address);
+    string coinbase = coinbase_tx_id(block_height);
+    utxo_manager.add_utxo(coinbase, 0, total_miner_reward, miner_address);
+    builder.create(coinbase, 0);
+    builder.finish();
 
     cout << "Block Reward: " << fixed << setprecision(3) << block_reward << " BTC" << endl;
     cout << "Total fees: " << fixed << setprecision(3) << total_fees << " BTC" << endl;
     cout << "Miner " << miner_address << " receives " << total_miner_reward << " BTC" << endl;
     cout << "Block mined successfully!" << endl;
+    if(mempool.fee_estimator)
+        mempool.fee_estimator->process_block(block_height, to_mine);
 
     time_t now = time(0); // time stamp for header
     char* dt = ctime(&now);
     string timestamp(dt);
     if (!timestamp.empty() && timestamp.back() == '\n') timestamp.pop_back();
 
-    return { block_height, miner_address, to_mine, total_fees, block_reward, timestamp };
+    crypto::SetHash merkle_root = compute_merkle_root(to_mine);
+    return { block_height, miner_address, move(to_mine), total_fees, block_reward, timestamp, utxo_manager.state_hash(),
+             merkle_root, (int64_t)now, 0, false };
+}
+
+// prunes every block more than depth blocks below the tip and frees its undo data,
+// so the chain can no longer be reorganized below that point; returns how many were pruned
+// pruned blocks are always a prefix of the chain: with last_pruned (the height of the newest
+// pruned block, kept by the caller) the scan starts above it instead of at height 1
+int prune_chain(vector<Block>& chain, vector<BlockUndo>& undo_log, int depth, int* last_pruned = nullptr) {
+    int pruned = 0;
+    int start = last_pruned ? min(*last_pruned, (int)chain.size()) : 0;
+    for (int i = start; i + depth < (int)chain.size(); ++i) {
+        if (chain[i].pruned) continue;
+        chain[i].prune();
+        if (i < (int)undo_log.size()) undo_log[i] = BlockUndo();
+        pruned++;
+    }
+    if (last_pruned) *last_pruned = max(*last_pruned, (int)chain.size() - depth);
+    return pruned;
 }
+
+#endif
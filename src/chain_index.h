@@ -0,0 +1,254 @@
+#ifndef CHAIN_INDEX_H
+#define CHAIN_INDEX_H
+
+#include<bits/stdc++.h>
+#include"block.h"
+using namespace std;
+
+//where a confirmed transaction lives
+struct TxLocation
+{
+    int height;
+    int position; //index in Block::transactions, -1 for the coinbase
+};
+
+//one line of an address history, delta is the net change for that address in the tx
+struct AddressEntry
+{
+    int height;
+    string tx_id;
+    double delta;
+};
+
+//optional lookup indexes over the blockchain, kept up to date block by block
+class ChainIndex
+{
+    //tx_id -> (amount, address) per output index, used to price inputs
+    unordered_map<string, vector<pair<double, string>>> outputs;
+    unordered_map<string, vector<pair<double, string>>> genesis_outputs;
+
+    static string coinbase_id(const Block& block)
+    {
+        return "coinbase_block_" + to_string(block.block_height);
+    }
+
+    //net per-address delta of one transaction, inputs are priced from the output table
+    static void tx_deltas(const Transaction& tx, const unordered_map<string, vector<pair<double, string>>>& outs, vector<pair<string, double>>& deltas)
+    {
+        deltas.clear();
+        auto credit = [&](const string& address, double amount) {
+            for(auto& d : deltas)
+            {
+                if(d.first == address)
+                {
+                    d.second += amount;
+                    return;
+                }
+            }
+            deltas.push_back({address, amount});
+        };
+        for(const auto& input : tx.inputs)
+        {
+            auto it = outs.find(input.prev_tx_id);
+            if(it == outs.end() || input.index < 0 || input.index >= (int)it->second.size())
+                continue; //source not indexed, amount unknown
+            const auto& prev = it->second[input.index];
+            credit(prev.second, -prev.first);
+        }
+        for(const auto& output : tx.outputs)
+            credit(output.address, output.amount);
+    }
+
+    static void block_outputs(const Block& block, vector<pair<string, vector<pair<double, string>>>>& result)
+    {
+        for(const auto& tx : block.transactions)
+        {
+            vector<pair<double, string>> outs;
+            for(const auto& o : tx.outputs)
+                outs.push_back({o.amount, o.address});
+            result.push_back({tx.tx_id, move(outs)});
+        }
+        result.push_back({coinbase_id(block), {{block.block_reward + block.total_fees, block.miner}}});
+    }
+
+    static void block_history(const Block& block, const unordered_map<string, vector<pair<double, string>>>& outs, vector<pair<string, AddressEntry>>& result)
+    {
+        vector<pair<string, double>> deltas;
+        for(const auto& tx : block.transactions)
+        {
+            tx_deltas(tx, outs, deltas);
+            for(const auto& d : deltas)
+                result.push_back({d.first, {block.block_height, tx.tx_id, d.second}});
+        }
+        result.push_back({block.miner, {block.block_height, coinbase_id(block), block.block_reward + block.total_fees}});
+    }
+
+public:
+    unordered_map<string, TxLocation> tx_index; //tx_id -> (height, position)
+    unordered_map<string, vector<AddressEntry>> address_index; //address -> history in chain order
+
+    //outputs that exist before the first block (genesis) so their spends can be priced
+    void add_genesis_output(const string& tx_id, int index, double amount, const string& owner)
+    {
+        auto& outs = genesis_outputs[tx_id];
+        if((int)outs.size() <= index)
+            outs.resize(index + 1, {0.0, ""});
+        outs[index] = {amount, owner};
+        outputs[tx_id] = outs;
+    }
+
+    //incremental update, call once per appended block
+    void index_block(const Block& block)
+    {
+        vector<pair<string, vector<pair<double, string>>>> outs;
+        block_outputs(block, outs);
+        for(auto& o : outs)
+            outputs[o.first] = move(o.second);
+
+        for(int i = 0; i < (int)block.transactions.size(); ++i)
+            tx_index[block.transactions[i].tx_id] = {block.block_height, i};
+        tx_index[coinbase_id(block)] = {block.block_height, -1};
+
+        vector<pair<string, AddressEntry>> history;
+        block_history(block, outputs, history);
+        for(auto& h : history)
+            address_index[h.first].push_back(move(h.second));
+    }
+
+    //reverse of index_block, only valid for the current tip
+    void unindex_block(const Block& block)
+    {
+        vector<string> ids;
+        for(const auto& tx : block.transactions)
+            ids.push_back(tx.tx_id);
+        ids.push_back(coinbase_id(block));
+        for(const auto& id : ids)
+        {
+            tx_index.erase(id);
+            outputs.erase(id);
+        }
+
+        vector<pair<string, AddressEntry>> history;
+        block_history(block, outputs, history);
+        for(const auto& h : history)
+        {
+            auto it = address_index.find(h.first);
+            if(it == address_index.end())
+                continue;
+            while(!it->second.empty() && it->second.back().height == block.block_height)
+                it->second.pop_back();
+            if(it->second.empty())
+                address_index.erase(it);
+        }
+    }
+
+    //drops everything derived from blocks, genesis outputs are kept
+    void clear()
+    {
+        tx_index.clear();
+        address_index.clear();
+        outputs = genesis_outputs;
+    }
+
+    //bulk (re)index of an existing chain
+    //pass 1 collects outputs and tx locations per chunk, pass 2 computes histories against the merged output table
+    //returns false, leaving the index empty, if a block is pruned: its transactions are gone
+    bool rebuild(const vector<Block>& chain, int num_threads = 0)
+    {
+        clear();
+        for(const auto& block : chain)
+        {
+            if(block.pruned)
+                return false;
+        }
+        if(chain.empty())
+            return true;
+        if(num_threads <= 0)
+            num_threads = max(1u, thread::hardware_concurrency());
+        int chunks = min<int>(num_threads, chain.size());
+        size_t per_chunk = (chain.size() + chunks - 1) / chunks;
+
+        vector<vector<pair<string, vector<pair<double, string>>>>> chunk_outputs(chunks);
+        vector<vector<pair<string, TxLocation>>> chunk_locations(chunks);
+        vector<thread> workers;
+        for(int c = 0; c < chunks; ++c)
+        {
+            workers.emplace_back([&, c]() {
+                size_t end = min(chain.size(), (c + 1) * per_chunk);
+                for(size_t b = c * per_chunk; b < end; ++b)
+                {
+                    const Block& block = chain[b];
+                    block_outputs(block, chunk_outputs[c]);
+                    for(int i = 0; i < (int)block.transactions.size(); ++i)
+                        chunk_locations[c].push_back({block.transactions[i].tx_id, {block.block_height, i}});
+                    chunk_locations[c].push_back({coinbase_id(block), {block.block_height, -1}});
+                }
+            });
+        }
+        for(auto& w : workers)
+            w.join();
+        workers.clear();
+
+        for(int c = 0; c < chunks; ++c)
+        {
+            for(auto& o : chunk_outputs[c])
+                outputs[o.first] = move(o.second);
+            for(auto& l : chunk_locations[c])
+                tx_index[l.first] = l.second;
+        }
+
+        vector<vector<pair<string, AddressEntry>>> chunk_history(chunks);
+        for(int c = 0; c < chunks; ++c)
+        {
+            workers.emplace_back([&, c]() {
+                size_t end = min(chain.size(), (c + 1) * per_chunk);
+                for(size_t b = c * per_chunk; b < end; ++b)
+                    block_history(chain[b], outputs, chunk_history[c]);
+            });
+        }
+        for(auto& w : workers)
+            w.join();
+
+        //merge in chunk order so every history stays sorted by height
+        for(int c = 0; c < chunks; ++c)
+        {
+            for(auto& h : chunk_history[c])
+                address_index[h.first].push_back(move(h.second));
+        }
+        return true;
+    }
+
+    bool find_tx(const string& tx_id, TxLocation& location) const
+    {
+        auto it = tx_index.find(tx_id);
+        if(it == tx_index.end())
+            return false;
+        location = it->second;
+        return true;
+    }
+
+    const vector<AddressEntry>& history(const string& address) const
+    {
+        static const vector<AddressEntry> empty;
+        auto it = address_index.find(address);
+        return it == address_index.end() ? empty : it->second;
+    }
+
+    void display_history(const string& address) const
+    {
+        const auto& entries = history(address);
+        cout << "\n--- History of " << address << " ---" << endl;
+        if(entries.empty())
+        {
+            cout << "No confirmed transactions." << endl;
+            return;
+        }
+        cout << left << setw(10) << "Height" << setw(25) << "TX ID" << setw(15) << "Delta" << endl;
+        for(const auto& e : entries)
+        {
+            cout << left << setw(10) << e.height << setw(25) << e.tx_id << setw(15) << fixed << setprecision(3) << e.delta << endl;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef COMPACT_BLOCK_H
+#define COMPACT_BLOCK_H
+
+#include<bits/stdc++.h>
+#include"block.h"
+#include"crypto.h"
+using namespace std;
+
+//compact block relay: the header, a 6-byte salted short id per transaction and full
+//copies only of the transactions the receiver is predicted not to have. The receiver
+//rebuilds the block from its own mempool and asks for whatever is still missing.
+struct CompactBlock
+{
+    int block_height;
+    string miner;
+    double total_fees;
+    double block_reward;
+    string timestamp;
+    int64_t time;
+    crypto::SetHash merkle_root; //over the full transactions, checked once the block is rebuilt
+    crypto::SetHash utxo_hash;
+    uint64_t nonce; //salts the short ids so collisions differ per block and per peer
+    vector<uint64_t> short_ids; //for every non-prefilled position, in block order
+    vector<pair<int, Transaction>> prefilled; //(position in block, transaction), ascending
+};
+
+const uint64_t SHORT_ID_MASK = 0xffffffffffffULL; //48 bits
+
+//siphash keys from the header and the nonce
+pair<uint64_t, uint64_t> short_id_keys(const CompactBlock& cb)
+{
+    ostringstream header;
+    header << cb.block_height << "|" << cb.miner << "|" << setprecision(17) << cb.total_fees << "|" << cb.block_reward << "|" << cb.timestamp << "|" << cb.time << "|"
+           << crypto::to_hex(cb.merkle_root.data(), cb.merkle_root.size()) << "|" << crypto::to_hex(cb.utxo_hash.data(), cb.utxo_hash.size()) << "|" << cb.nonce;
+    crypto::Digest d = crypto::sha512(header.str());
+    uint64_t k0 = 0, k1 = 0;
+    for(int i = 7; i >= 0; --i)
+    {
+        k0 = (k0 << 8) | d[i];
+        k1 = (k1 << 8) | d[8 + i];
+    }
+    return {k0, k1};
+}
+
+uint64_t short_tx_id(const pair<uint64_t, uint64_t>& keys, const string& tx_id)
+{
+    return crypto::siphash24(keys.first, keys.second, tx_id) & SHORT_ID_MASK;
+}
+
+//transactions whose ids are not in peer_has are sent in full
+CompactBlock make_compact_block(const Block& block, const unordered_set<string>& peer_has, uint64_t nonce)
+{
+    CompactBlock cb;
+    cb.block_height = block.block_height;
+    cb.miner = block.miner;
+    cb.total_fees = block.total_fees;
+    cb.block_reward = block.block_reward;
+    cb.timestamp = block.timestamp;
+    cb.time = block.time;
+    cb.merkle_root = block.has_merkle_root() ? block.merkle_root : compute_merkle_root(block.transactions);
+    cb.utxo_hash = block.utxo_hash;
+    cb.nonce = nonce;
+    auto keys = short_id_keys(cb);
+    for(size_t i = 0; i < block.transactions.size(); ++i)
+    {
+        const Transaction& tx = block.transactions[i];
+        if(peer_has.count(tx.tx_id))
+            cb.short_ids.push_back(short_tx_id(keys, tx.tx_id));
+        else
+            cb.prefilled.push_back({(int)i, tx});
+    }
+    return cb;
+}
+
+//serialized sizes, same conventions as tx_size()
+//header: height, miner, fees, reward, timestamp, time, Merkle root, UTXO hash
+size_t block_header_size(const string& miner, const string& timestamp)
+{
+    return 8 + (8 + miner.size()) + 8 + 8 + (8 + timestamp.size()) + 8 + 32 + 32;
+}
+
+size_t block_size(const Block& block)
+{
+    size_t size = block_header_size(block.miner, block.timestamp) + 8;
+    for(const auto& tx : block.transactions)
+        size += tx_size(tx);
+    return size;
+}
+
+size_t compact_block_size(const CompactBlock& cb)
+{
+    size_t size = block_header_size(cb.miner, cb.timestamp) + 8; // + nonce
+    size += 8 + 6 * cb.short_ids.size();
+    size += 8;
+    for(const auto& p : cb.prefilled)
+        size += 8 + tx_size(p.second);
+    return size;
+}
+
+//block being rebuilt, missing lists the positions no local transaction matched
+//invalid is set when even the transactions the sender supplied do not hash to its Merkle root
+struct CompactReconstruction
+{
+    Block block;
+    vector<int> missing;
+    vector<int> from_mempool; //positions filled from the local mempool, ascending
+    bool invalid = false;
+
+    bool complete() const
+    {
+        return missing.empty() && !invalid;
+    }
+};
+
+//once every position is filled, checks the transactions against the sender's Merkle root.
+//A short id collision can pick the wrong mempool transaction, so on a mismatch every
+//position filled from the mempool is requested in full instead; if none was, the block
+//itself is bad. Returns true if the block matches
+bool check_merkle_root(CompactReconstruction& r, const CompactBlock& cb)
+{
+    if(!r.missing.empty() || cb.merkle_root == crypto::SetHash() || compute_merkle_root(r.block.transactions) == cb.merkle_root)
+        return true;
+    if(r.from_mempool.empty())
+        r.invalid = true;
+    r.missing.swap(r.from_mempool);
+    r.from_mempool.clear();
+    return false;
+}
+
+//rebuilds the block from prefilled transactions and the local mempool
+//the mempool is indexed once by short id (O(mempool)), each position is then one lookup;
+//ids matching two mempool transactions are ambiguous and reported as missing
+template<typename MempoolType>
+CompactReconstruction reconstruct_block(const CompactBlock& cb, const MempoolType& mempool)
+{
+    CompactReconstruction r;
+    r.block.block_height = cb.block_height;
+    r.block.miner = cb.miner;
+    r.block.total_fees = cb.total_fees;
+    r.block.block_reward = cb.block_reward;
+    r.block.timestamp = cb.timestamp;
+    r.block.time = cb.time;
+    r.block.merkle_root = cb.merkle_root;
+    r.block.utxo_hash = cb.utxo_hash;
+    size_t n = cb.short_ids.size() + cb.prefilled.size();
+    r.block.transactions.assign(n, Transaction());
+
+    auto keys = short_id_keys(cb);
+    unordered_map<uint64_t, int> table; //short id -> mempool index, -1 if ambiguous
+    table.reserve(mempool.transactions.size() * 2);
+    for(size_t i = 0; i < mempool.transactions.size(); ++i)
+    {
+        auto ins = table.insert({short_tx_id(keys, mempool.transactions[i].tx_id), (int)i});
+        if(!ins.second)
+            ins.first->second = -1;
+    }
+
+    vector<bool> filled(n, false);
+    for(const auto& p : cb.prefilled)
+    {
+        if(p.first < 0 || p.first >= (int)n)
+            continue;
+        r.block.transactions[p.first] = p.second;
+        filled[p.first] = true;
+    }
+    size_t next = 0;
+    for(size_t pos = 0; pos < n; ++pos)
+    {
+        if(filled[pos])
+            continue;
+        if(next >= cb.short_ids.size())
+        {
+            r.missing.push_back(pos);
+            continue;
+        }
+        auto it = table.find(cb.short_ids[next++]);
+        if(it == table.end() || it->second < 0)
+            r.missing.push_back(pos);
+        else
+        {
+            r.block.transactions[pos] = mempool.transactions[it->second];
+            r.from_mempool.push_back(pos);
+        }
+    }
+    check_merkle_root(r, cb);
+    return r;
+}
+
+//supplies the transactions requested for r.missing, in the same order
+//returns false if the count is wrong, one does not match its short id, or the block then
+//fails its Merkle root check (r.missing then lists what to request next, see check_merkle_root)
+bool fill_missing(CompactReconstruction& r, const CompactBlock& cb, const vector<Transaction>& txs)
+{
+    if(txs.size() != r.missing.size())
+        return false;
+    auto keys = short_id_keys(cb);
+    //short id of each non-prefilled position
+    unordered_map<int, uint64_t> expected;
+    set<int> prefilled;
+    for(const auto& p : cb.prefilled)
+        prefilled.insert(p.first);
+    size_t next = 0;
+    for(int pos = 0; pos < (int)r.block.transactions.size() && next < cb.short_ids.size(); ++pos)
+    {
+        if(!prefilled.count(pos))
+            expected[pos] = cb.short_ids[next++];
+    }
+    for(size_t i = 0; i < txs.size(); ++i)
+    {
+        auto it = expected.find(r.missing[i]);
+        if(it == expected.end() || short_tx_id(keys, txs[i].tx_id) != it->second)
+            return false;
+    }
+    for(size_t i = 0; i < txs.size(); ++i)
+        r.block.transactions[r.missing[i]] = txs[i];
+    r.missing.clear();
+    return check_merkle_root(r, cb);
+}
+
+#endif
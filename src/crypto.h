@@ -0,0 +1,622 @@
+#ifndef CRYPTO_H
+#define CRYPTO_H
+
+#include<bits/stdc++.h>
+using namespace std;
+
+//self-contained SHA-512 and Ed25519 (RFC 8032), field arithmetic follows TweetNaCl
+//kept in its own namespace because the field helpers have very short names
+namespace crypto
+{
+
+typedef array<uint8_t, 64> Digest;
+typedef array<uint8_t, 32> PublicKey;
+typedef array<uint8_t, 64> SecretKey; //32-byte seed followed by the public key
+typedef array<uint8_t, 64> Signature;
+
+// ---------- SHA-512 ----------
+
+class Sha512
+{
+    uint64_t state[8];
+    uint8_t buffer[128];
+    size_t buffered;
+    uint64_t total;
+
+    static uint64_t rotr(uint64_t x, int n)
+    {
+        return (x >> n) | (x << (64 - n));
+    }
+
+    void compress(const uint8_t* block)
+    {
+        static const uint64_t K[80] = {
+            0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL,
+            0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+            0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL, 0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+            0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+            0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL, 0x983e5152ee66dfabULL,
+            0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+            0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL,
+            0x53380d139d95b3dfULL, 0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+            0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+            0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL, 0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+            0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL,
+            0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+            0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL, 0xca273eceea26619cULL,
+            0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+            0x113f9804bef90daeULL, 0x1b710b35131c471bULL, 0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+            0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL};
+        uint64_t w[80];
+        for(int i = 0; i < 16; ++i)
+        {
+            w[i] = 0;
+            for(int j = 0; j < 8; ++j)
+                w[i] = (w[i] << 8) | block[i * 8 + j];
+        }
+        for(int i = 16; i < 80; ++i)
+        {
+            uint64_t s0 = rotr(w[i - 15], 1) ^ rotr(w[i - 15], 8) ^ (w[i - 15] >> 7);
+            uint64_t s1 = rotr(w[i - 2], 19) ^ rotr(w[i - 2], 61) ^ (w[i - 2] >> 6);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for(int i = 0; i < 80; ++i)
+        {
+            uint64_t t1 = h + (rotr(e, 14) ^ rotr(e, 18) ^ rotr(e, 41)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint64_t t2 = (rotr(a, 28) ^ rotr(a, 34) ^ rotr(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+public:
+    Sha512()
+    {
+        static const uint64_t iv[8] = {
+            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
+        for(int i = 0; i < 8; ++i)
+            state[i] = iv[i];
+        buffered = 0;
+        total = 0;
+    }
+
+    Sha512& update(const uint8_t* data, size_t len)
+    {
+        total += len;
+        while(len > 0)
+        {
+            size_t take = min(len, sizeof(buffer) - buffered);
+            memcpy(buffer + buffered, data, take);
+            buffered += take;
+            data += take;
+            len -= take;
+            if(buffered == sizeof(buffer))
+            {
+                compress(buffer);
+                buffered = 0;
+            }
+        }
+        return *this;
+    }
+
+    Sha512& update(const string& data)
+    {
+        return update((const uint8_t*)data.data(), data.size());
+    }
+
+    Digest final()
+    {
+        uint64_t bits = total * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        uint8_t zero = 0;
+        while(buffered != 112)
+            update(&zero, 1);
+        uint8_t length[16] = {0};
+        for(int i = 0; i < 8; ++i)
+            length[15 - i] = (uint8_t)(bits >> (8 * i));
+        update(length, 16);
+        Digest out;
+        for(int i = 0; i < 8; ++i)
+            for(int j = 0; j < 8; ++j)
+                out[i * 8 + j] = (uint8_t)(state[i] >> (56 - 8 * j));
+        return out;
+    }
+};
+
+inline Digest sha512(const uint8_t* data, size_t len)
+{
+    return Sha512().update(data, len).final();
+}
+
+inline Digest sha512(const string& data)
+{
+    return Sha512().update(data).final();
+}
+
+inline string to_hex(const uint8_t* data, size_t len)
+{
+    static const char* digits = "0123456789abcdef";
+    string out;
+    out.reserve(len * 2);
+    for(size_t i = 0; i < len; ++i)
+    {
+        out.push_back(digits[data[i] >> 4]);
+        out.push_back(digits[data[i] & 15]);
+    }
+    return out;
+}
+
+// ---------- SipHash-2-4 ----------
+
+//keyed 64-bit hash for short ids, not a substitute for SHA-512
+inline uint64_t siphash24(uint64_t k0, uint64_t k1, const uint8_t* data, size_t len)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+    auto rotl = [](uint64_t x, int b) { return (x << b) | (x >> (64 - b)); };
+    auto round = [&]() {
+        v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+        v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+    };
+    size_t full = len - len % 8;
+    for(size_t i = 0; i < full; i += 8)
+    {
+        uint64_t m = 0;
+        for(int j = 7; j >= 0; --j)
+            m = (m << 8) | data[i + j];
+        v3 ^= m;
+        round();
+        round();
+        v0 ^= m;
+    }
+    uint64_t last = (uint64_t)len << 56;
+    for(size_t j = 0; j < len % 8; ++j)
+        last |= (uint64_t)data[full + j] << (8 * j);
+    v3 ^= last;
+    round();
+    round();
+    v0 ^= last;
+    v2 ^= 0xff;
+    for(int i = 0; i < 4; ++i)
+        round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+inline uint64_t siphash24(uint64_t k0, uint64_t k1, const string& data)
+{
+    return siphash24(k0, k1, (const uint8_t*)data.data(), data.size());
+}
+
+// ---------- Ed25519 ----------
+
+namespace detail
+{
+typedef int64_t gf[16];
+
+static const gf gf0 = {0};
+static const gf gf1 = {1};
+static const gf D = {0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070, 0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203};
+static const gf D2 = {0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0, 0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406};
+static const gf X = {0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c, 0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169};
+static const gf Y = {0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666};
+static const gf I = {0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43, 0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83};
+//group order, little endian
+static const uint64_t L[32] = {0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+                               0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10};
+
+inline void set25519(gf r, const gf a)
+{
+    for(int i = 0; i < 16; ++i) r[i] = a[i];
+}
+
+inline void car25519(gf o)
+{
+    for(int i = 0; i < 16; ++i)
+    {
+        o[i] += (1LL << 16);
+        int64_t c = o[i] >> 16;
+        o[(i + 1) * (i < 15)] += c - 1 + 37 * (c - 1) * (i == 15);
+        o[i] -= c * (1LL << 16);
+    }
+}
+
+inline void sel25519(gf p, gf q, int b)
+{
+    int64_t c = ~(b - 1);
+    for(int i = 0; i < 16; ++i)
+    {
+        int64_t t = c & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+inline void pack25519(uint8_t* o, const gf n)
+{
+    gf m, t;
+    set25519(t, n);
+    car25519(t);
+    car25519(t);
+    car25519(t);
+    for(int j = 0; j < 2; ++j)
+    {
+        m[0] = t[0] - 0xffed;
+        for(int i = 1; i < 15; ++i)
+        {
+            m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+            m[i - 1] &= 0xffff;
+        }
+        m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+        int b = (m[15] >> 16) & 1;
+        m[14] &= 0xffff;
+        sel25519(t, m, 1 - b);
+    }
+    for(int i = 0; i < 16; ++i)
+    {
+        o[2 * i] = t[i] & 0xff;
+        o[2 * i + 1] = t[i] >> 8;
+    }
+}
+
+inline bool neq25519(const gf a, const gf b)
+{
+    uint8_t c[32], d[32];
+    pack25519(c, a);
+    pack25519(d, b);
+    return memcmp(c, d, 32) != 0;
+}
+
+inline uint8_t par25519(const gf a)
+{
+    uint8_t d[32];
+    pack25519(d, a);
+    return d[0] & 1;
+}
+
+inline void unpack25519(gf o, const uint8_t* n)
+{
+    for(int i = 0; i < 16; ++i) o[i] = n[2 * i] + ((int64_t)n[2 * i + 1] << 8);
+    o[15] &= 0x7fff;
+}
+
+inline void A(gf o, const gf a, const gf b)
+{
+    for(int i = 0; i < 16; ++i) o[i] = a[i] + b[i];
+}
+
+inline void Z(gf o, const gf a, const gf b)
+{
+    for(int i = 0; i < 16; ++i) o[i] = a[i] - b[i];
+}
+
+inline void M(gf o, const gf a, const gf b)
+{
+    int64_t t[31] = {0};
+    for(int i = 0; i < 16; ++i)
+        for(int j = 0; j < 16; ++j)
+            t[i + j] += a[i] * b[j];
+    for(int i = 0; i < 15; ++i) t[i] += 38 * t[i + 16];
+    for(int i = 0; i < 16; ++i) o[i] = t[i];
+    car25519(o);
+    car25519(o);
+}
+
+inline void S(gf o, const gf a)
+{
+    M(o, a, a);
+}
+
+inline void inv25519(gf o, const gf i)
+{
+    gf c;
+    set25519(c, i);
+    for(int a = 253; a >= 0; --a)
+    {
+        S(c, c);
+        if(a != 2 && a != 4) M(c, c, i);
+    }
+    set25519(o, c);
+}
+
+inline void pow2523(gf o, const gf i)
+{
+    gf c;
+    set25519(c, i);
+    for(int a = 250; a >= 0; --a)
+    {
+        S(c, c);
+        if(a != 1) M(c, c, i);
+    }
+    set25519(o, c);
+}
+
+//extended coordinates (X, Y, Z, T)
+inline void add(gf p[4], gf q[4])
+{
+    gf a, b, c, d, t, e, f, g, h;
+    Z(a, p[1], p[0]);
+    Z(t, q[1], q[0]);
+    M(a, a, t);
+    A(b, p[0], p[1]);
+    A(t, q[0], q[1]);
+    M(b, b, t);
+    M(c, p[3], q[3]);
+    M(c, c, D2);
+    M(d, p[2], q[2]);
+    A(d, d, d);
+    Z(e, b, a);
+    Z(f, d, c);
+    A(g, d, c);
+    A(h, b, a);
+    M(p[0], e, f);
+    M(p[1], h, g);
+    M(p[2], g, f);
+    M(p[3], e, h);
+}
+
+inline void cswap(gf p[4], gf q[4], uint8_t b)
+{
+    for(int i = 0; i < 4; ++i) sel25519(p[i], q[i], b);
+}
+
+inline void pack(uint8_t* r, gf p[4])
+{
+    gf tx, ty, zi;
+    inv25519(zi, p[2]);
+    M(tx, p[0], zi);
+    M(ty, p[1], zi);
+    pack25519(r, ty);
+    r[31] ^= par25519(tx) << 7;
+}
+
+inline void scalarmult(gf p[4], gf q[4], const uint8_t* s)
+{
+    set25519(p[0], gf0);
+    set25519(p[1], gf1);
+    set25519(p[2], gf1);
+    set25519(p[3], gf0);
+    for(int i = 255; i >= 0; --i)
+    {
+        uint8_t b = (s[i / 8] >> (i & 7)) & 1;
+        cswap(p, q, b);
+        add(q, p);
+        add(p, p);
+        cswap(p, q, b);
+    }
+}
+
+inline void scalarbase(gf p[4], const uint8_t* s)
+{
+    gf q[4];
+    set25519(q[0], X);
+    set25519(q[1], Y);
+    set25519(q[2], gf1);
+    M(q[3], X, Y);
+    scalarmult(p, q, s);
+}
+
+inline void modL(uint8_t* r, int64_t x[64])
+{
+    int64_t carry;
+    for(int i = 63; i >= 32; --i)
+    {
+        carry = 0;
+        int j;
+        for(j = i - 32; j < i - 12; ++j)
+        {
+            x[j] += carry - 16 * x[i] * (int64_t)L[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+    carry = 0;
+    for(int j = 0; j < 32; ++j)
+    {
+        x[j] += carry - (x[31] >> 4) * (int64_t)L[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+    for(int j = 0; j < 32; ++j) x[j] -= carry * (int64_t)L[j];
+    for(int i = 0; i < 32; ++i)
+    {
+        x[i + 1] += x[i] >> 8;
+        r[i] = x[i] & 255;
+    }
+}
+
+inline void reduce(uint8_t* r)
+{
+    int64_t x[64];
+    for(int i = 0; i < 64; ++i) x[i] = (uint64_t)r[i];
+    for(int i = 0; i < 64; ++i) r[i] = 0;
+    modL(r, x);
+}
+
+//decodes a point and negates it, false if it is not on the curve
+inline bool unpackneg(gf r[4], const uint8_t p[32])
+{
+    gf t, chk, num, den, den2, den4, den6;
+    set25519(r[2], gf1);
+    unpack25519(r[1], p);
+    S(num, r[1]);
+    M(den, num, D);
+    Z(num, num, r[2]);
+    A(den, r[2], den);
+
+    S(den2, den);
+    S(den4, den2);
+    M(den6, den4, den2);
+    M(t, den6, num);
+    M(t, t, den);
+
+    pow2523(t, t);
+    M(t, t, num);
+    M(t, t, den);
+    M(t, t, den);
+    M(r[0], t, den);
+
+    S(chk, r[0]);
+    M(chk, chk, den);
+    if(neq25519(chk, num)) M(r[0], r[0], I);
+
+    S(chk, r[0]);
+    M(chk, chk, den);
+    if(neq25519(chk, num)) return false;
+
+    if(par25519(r[0]) == (p[31] >> 7)) Z(r[0], gf0, r[0]);
+    M(r[3], r[0], r[1]);
+    return true;
+}
+
+//s must be below the group order (rejects malleated signatures)
+inline bool scalar_canonical(const uint8_t* s)
+{
+    for(int i = 31; i >= 0; --i)
+    {
+        if(s[i] < L[i]) return true;
+        if(s[i] > L[i]) return false;
+    }
+    return false;
+}
+
+inline void clamp_hash(const SecretKey& sk, Digest& d)
+{
+    d = sha512(sk.data(), 32);
+    d[0] &= 248;
+    d[31] &= 127;
+    d[31] |= 64;
+}
+} // namespace detail
+
+//derives the keypair from a 32-byte seed
+inline void keypair_from_seed(const uint8_t seed[32], PublicKey& pk, SecretKey& sk)
+{
+    using namespace detail;
+    for(int i = 0; i < 32; ++i) sk[i] = seed[i];
+    Digest d;
+    clamp_hash(sk, d);
+    gf p[4];
+    scalarbase(p, d.data());
+    pack(pk.data(), p);
+    for(int i = 0; i < 32; ++i) sk[32 + i] = pk[i];
+}
+
+inline Signature sign(const uint8_t* msg, size_t len, const SecretKey& sk)
+{
+    using namespace detail;
+    Digest d;
+    clamp_hash(sk, d);
+
+    Digest r = Sha512().update(d.data() + 32, 32).update(msg, len).final();
+    reduce(r.data());
+    gf p[4];
+    scalarbase(p, r.data());
+    Signature sig;
+    pack(sig.data(), p);
+
+    Digest h = Sha512().update(sig.data(), 32).update(sk.data() + 32, 32).update(msg, len).final();
+    reduce(h.data());
+
+    int64_t x[64] = {0};
+    for(int i = 0; i < 32; ++i) x[i] = (uint64_t)r[i];
+    for(int i = 0; i < 32; ++i)
+        for(int j = 0; j < 32; ++j)
+            x[i + j] += h[i] * (uint64_t)d[j];
+    modL(sig.data() + 32, x);
+    return sig;
+}
+
+inline bool verify(const uint8_t* msg, size_t len, const Signature& sig, const PublicKey& pk)
+{
+    using namespace detail;
+    if(!scalar_canonical(sig.data() + 32))
+        return false;
+    gf p[4], q[4];
+    if(!unpackneg(q, pk.data()))
+        return false;
+    Digest h = Sha512().update(sig.data(), 32).update(pk.data(), 32).update(msg, len).final();
+    reduce(h.data());
+    scalarmult(p, q, h.data());
+    scalarbase(q, sig.data() + 32);
+    add(p, q);
+    uint8_t t[32];
+    pack(t, p);
+    return memcmp(sig.data(), t, 32) == 0;
+}
+
+// ---------- MuHash ----------
+
+typedef array<uint8_t, 32> SetHash;
+
+//order-independent hash of a multiset: every element maps to a field element mod 2^255-19,
+//inserts multiply the numerator, removals the denominator, so both are O(1) and the
+//single inversion happens only in finalize(). Not as strong as MuHash3072, but any change
+//to the set changes the value except with negligible probability.
+class MuHash
+{
+    detail::gf num;
+    detail::gf den;
+
+    static void element(detail::gf e, const uint8_t* data, size_t len)
+    {
+        Digest d = sha512(data, len);
+        detail::unpack25519(e, d.data());
+    }
+
+public:
+    MuHash()
+    {
+        detail::set25519(num, detail::gf1);
+        detail::set25519(den, detail::gf1);
+    }
+
+    void insert(const uint8_t* data, size_t len)
+    {
+        detail::gf e;
+        element(e, data, len);
+        detail::M(num, num, e);
+    }
+
+    void remove(const uint8_t* data, size_t len)
+    {
+        detail::gf e;
+        element(e, data, len);
+        detail::M(den, den, e);
+    }
+
+    //hash of the union of both multisets
+    void combine(const MuHash& other)
+    {
+        detail::M(num, num, other.num);
+        detail::M(den, den, other.den);
+    }
+
+    SetHash finalize() const
+    {
+        detail::gf inv, v;
+        detail::inv25519(inv, den);
+        detail::M(v, num, inv);
+        uint8_t packed[32];
+        detail::pack25519(packed, v);
+        Digest d = sha512(packed, 32);
+        SetHash out;
+        memcpy(out.data(), d.data(), 32);
+        return out;
+    }
+};
+
+} // namespace crypto
+
+#endif
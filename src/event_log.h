@@ -0,0 +1,301 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include<bits/stdc++.h>
+#include"crypto.h"
+using namespace std;
+
+//binary log of the externally driven events of a simulator run, replayable at full speed
+//layout: 8 byte magic, then records of a type byte followed by its fields. Integers are
+//LEB128 varints (times zigzag encoded), doubles 8 raw little-endian bytes, strings a
+//varint length and the bytes
+enum SimEventType : uint8_t
+{
+    EVENT_CONFIG = 1,    //constructor parameters and RNG seed, always first
+    EVENT_CREATE_TX = 2, //create_transaction(sender, recipient, amount)
+    EVENT_MINE = 3,      //mine_next_block(miner)
+    EVENT_PRUNING = 4,   //enable_pruning(depth)
+    EVENT_END = 5        //final state hash, always last
+};
+
+struct SimConfig
+{
+    double gas_fee;
+    double block_reward;
+    int mempool_maxsize;
+    int k;
+    uint64_t mempool_max_bytes;
+    int64_t mempool_expiry;
+    uint64_t seed;
+};
+
+struct SimEvent
+{
+    SimEventType type;
+    int64_t time = 0; //seconds since the run started, drives the mempool clock on replay
+    string sender, recipient, miner;
+    double amount = 0;
+    int64_t depth = 0;
+    crypto::SetHash hash = {};
+};
+
+struct ReplayStats
+{
+    size_t events;
+    double elapsed_ms;
+    crypto::SetHash state_hash;
+};
+
+static const char EVENT_LOG_MAGIC[8] = {'S', 'I', 'M', 'L', 'O', 'G', 1, '\n'};
+
+class EventLogWriter
+{
+    FILE* file = nullptr;
+    string buffer;
+    size_t count = 0;
+
+    void put_varint(uint64_t v)
+    {
+        while(v >= 0x80)
+        {
+            buffer += (char)(v | 0x80);
+            v >>= 7;
+        }
+        buffer += (char)v;
+    }
+
+    void put_time(int64_t t)
+    {
+        put_varint(((uint64_t)t << 1) ^ (uint64_t)(t >> 63));
+    }
+
+    void put_u64(uint64_t v)
+    {
+        for(int i = 0; i < 8; ++i)
+            buffer += (char)(v >> (8 * i));
+    }
+
+    void put_double(double d)
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        put_u64(bits);
+    }
+
+    void put_string(const string& s)
+    {
+        put_varint(s.size());
+        buffer += s;
+    }
+
+    void maybe_flush()
+    {
+        if(buffer.size() >= (1 << 16))
+            flush();
+    }
+
+public:
+    ~EventLogWriter()
+    {
+        close();
+    }
+
+    pair<bool, string> open(const string& path, const SimConfig& config)
+    {
+        close();
+        file = fopen(path.c_str(), "wb");
+        if(!file)
+            return {false, "Error: cannot open " + path + ": " + strerror(errno)};
+        buffer.assign(EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+        buffer += (char)EVENT_CONFIG;
+        put_double(config.gas_fee);
+        put_double(config.block_reward);
+        put_varint(config.mempool_maxsize);
+        put_varint(config.k);
+        put_varint(config.mempool_max_bytes);
+        put_time(config.mempool_expiry);
+        put_u64(config.seed);
+        count = 1;
+        return {true, "Recording events to " + path};
+    }
+
+    bool is_open() const
+    {
+        return file != nullptr;
+    }
+
+    size_t events() const
+    {
+        return count;
+    }
+
+    void write(const SimEvent& e)
+    {
+        if(!file)
+            return;
+        buffer += (char)e.type;
+        put_time(e.time);
+        switch(e.type)
+        {
+        case EVENT_CREATE_TX:
+            put_string(e.sender);
+            put_string(e.recipient);
+            put_double(e.amount);
+            break;
+        case EVENT_MINE:
+            put_string(e.miner);
+            break;
+        case EVENT_PRUNING:
+            put_varint(e.depth);
+            break;
+        case EVENT_END:
+            buffer.append((const char*)e.hash.data(), e.hash.size());
+            break;
+        default:
+            break;
+        }
+        count++;
+        maybe_flush();
+    }
+
+    void flush()
+    {
+        if(file && !buffer.empty())
+            fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+        if(file)
+            fflush(file);
+    }
+
+    void close()
+    {
+        if(!file)
+            return;
+        flush();
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+class EventLogReader
+{
+    string data;
+    size_t pos = 0;
+
+    bool get_varint(uint64_t& v)
+    {
+        v = 0;
+        for(int shift = 0; shift < 64 && pos < data.size(); shift += 7)
+        {
+            uint8_t b = data[pos++];
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if(!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool get_time(int64_t& t)
+    {
+        uint64_t v;
+        if(!get_varint(v))
+            return false;
+        t = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+        return true;
+    }
+
+    bool get_u64(uint64_t& v)
+    {
+        if(pos + 8 > data.size())
+            return false;
+        v = 0;
+        for(int i = 0; i < 8; ++i)
+            v |= (uint64_t)(uint8_t)data[pos + i] << (8 * i);
+        pos += 8;
+        return true;
+    }
+
+    bool get_double(double& d)
+    {
+        uint64_t bits;
+        if(!get_u64(bits))
+            return false;
+        memcpy(&d, &bits, sizeof(d));
+        return true;
+    }
+
+    bool get_string(string& s)
+    {
+        uint64_t n;
+        if(!get_varint(n) || n > data.size() - pos)
+            return false;
+        s.assign(data, pos, n);
+        pos += n;
+        return true;
+    }
+
+public:
+    //loads the log and decodes its configuration record
+    pair<bool, string> open(const string& path, SimConfig& config)
+    {
+        ifstream in(path, ios::binary);
+        if(!in)
+            return {false, "Error: cannot open " + path};
+        data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        pos = 0;
+        if(data.size() < sizeof(EVENT_LOG_MAGIC) || memcmp(data.data(), EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC)) != 0)
+            return {false, "Error: " + path + " is not an event log"};
+        pos = sizeof(EVENT_LOG_MAGIC);
+        uint64_t maxsize, k, max_bytes;
+        if(pos >= data.size() || data[pos++] != EVENT_CONFIG || !get_double(config.gas_fee) || !get_double(config.block_reward)
+           || !get_varint(maxsize) || !get_varint(k) || !get_varint(max_bytes) || !get_time(config.mempool_expiry) || !get_u64(config.seed))
+            return {false, "Error: " + path + " has no valid configuration record"};
+        config.mempool_maxsize = maxsize;
+        config.k = k;
+        config.mempool_max_bytes = max_bytes;
+        return {true, ""};
+    }
+
+    //false at the end of the log; error is set if the log is truncated or corrupt
+    bool next(SimEvent& e, string& error)
+    {
+        error.clear();
+        if(pos >= data.size())
+            return false;
+        e = SimEvent();
+        e.type = (SimEventType)(uint8_t)data[pos++];
+        bool ok = get_time(e.time);
+        uint64_t depth = 0;
+        switch(e.type)
+        {
+        case EVENT_CREATE_TX:
+            ok = ok && get_string(e.sender) && get_string(e.recipient) && get_double(e.amount);
+            break;
+        case EVENT_MINE:
+            ok = ok && get_string(e.miner);
+            break;
+        case EVENT_PRUNING:
+            ok = ok && get_varint(depth);
+            e.depth = depth;
+            break;
+        case EVENT_END:
+            ok = ok && pos + e.hash.size() <= data.size();
+            if(ok)
+            {
+                memcpy(e.hash.data(), data.data() + pos, e.hash.size());
+                pos += e.hash.size();
+            }
+            break;
+        default:
+            ok = false;
+        }
+        if(!ok)
+        {
+            error = "Error: corrupt event at offset " + to_string(pos);
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
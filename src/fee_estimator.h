@@ -0,0 +1,272 @@
+#ifndef FEE_ESTIMATOR_H
+#define FEE_ESTIMATOR_H
+
+#include<bits/stdc++.h>
+#include"transaction.h"
+using namespace std;
+
+//fee rate estimator over recent blocks (fee rates in BTC per byte, see fee_rate())
+//transactions are bucketed by fee rate on entering the mempool; when a block confirms
+//them the number of blocks they waited is recorded in decaying per-bucket histograms.
+//transactions still waiting count as failures for every target they have already missed.
+class FeeEstimator
+{
+    vector<double> bounds; //lower fee rate bound of each bucket
+    double min_rate;
+    double spacing;
+    int max_target;
+    double decay;
+    double success_threshold;
+    double min_data; //decayed tx count before a bucket range is trusted
+
+    vector<double> tx_count; //confirmed txs per bucket (decayed)
+    vector<double> fee_sum; //sum of their fee rates (decayed)
+    vector<vector<double>> conf; //conf[t][b]: confirmed within t+1 blocks (decayed)
+    vector<vector<int>> unconf; //unconf[entry_height % max_target][b]: still waiting
+    vector<int> old_unconf; //waiting max_target blocks or more
+    unordered_map<string, pair<int, int>> tracked; //tx_id -> (entry height, bucket)
+    int best_height;
+
+    void reset_unconfirmed()
+    {
+        unconf.assign(max_target, vector<int>(bounds.size(), 0));
+        old_unconf.assign(bounds.size(), 0);
+        tracked.clear();
+    }
+
+    //removes a tracked tx from the waiting counts
+    void untrack(unordered_map<string, pair<int, int>>::iterator it)
+    {
+        int entry = it->second.first, bucket = it->second.second;
+        if(best_height - entry >= max_target)
+            old_unconf[bucket]--;
+        else
+            unconf[entry % max_target][bucket]--;
+        tracked.erase(it);
+    }
+
+public:
+    FeeEstimator(double min_rate = 1e-7, double max_rate = 1e-1, double spacing = 1.5, int max_target = 12, double decay = 0.9)
+    {
+        this->min_rate = min_rate;
+        this->spacing = spacing;
+        this->max_target = max_target;
+        this->decay = decay;
+        success_threshold = 0.85;
+        min_data = 1.0;
+        for(double b = min_rate; b < max_rate; b *= spacing)
+            bounds.push_back(b);
+        tx_count.assign(bounds.size(), 0);
+        fee_sum.assign(bounds.size(), 0);
+        conf.assign(max_target, vector<double>(bounds.size(), 0));
+        best_height = 0;
+        reset_unconfirmed();
+    }
+
+    int num_buckets() const
+    {
+        return bounds.size();
+    }
+
+    int get_max_target() const
+    {
+        return max_target;
+    }
+
+    //O(1) bucket lookup, rates below the first bound land in bucket 0
+    int bucket_of(double rate) const
+    {
+        if(rate <= min_rate)
+            return 0;
+        int b = (int)floor(log(rate / min_rate) / log(spacing) + 1e-9);
+        return min(b, (int)bounds.size() - 1);
+    }
+
+    //a transaction entered the mempool
+    void process_transaction(const Transaction& tx)
+    {
+        if(tracked.count(tx.tx_id))
+            return;
+        int bucket = bucket_of(fee_rate(tx));
+        tracked[tx.tx_id] = {best_height, bucket};
+        unconf[best_height % max_target][bucket]++;
+    }
+
+    //a transaction left the mempool without being confirmed (evicted, expired, conflicted)
+    void remove_transaction(const string& tx_id)
+    {
+        auto it = tracked.find(tx_id);
+        if(it != tracked.end())
+            untrack(it);
+    }
+
+    //a block at this height confirmed these transactions
+    void process_block(int height, const vector<Transaction>& txs)
+    {
+        if(height <= best_height)
+            return; //stale or replayed block
+        for(int h = best_height + 1; h <= height; ++h)
+        {
+            //entries from max_target blocks ago age out of the ring
+            auto& slot = unconf[h % max_target];
+            for(size_t b = 0; b < bounds.size(); ++b)
+            {
+                old_unconf[b] += slot[b];
+                slot[b] = 0;
+            }
+        }
+        best_height = height;
+
+        for(size_t b = 0; b < bounds.size(); ++b)
+        {
+            tx_count[b] *= decay;
+            fee_sum[b] *= decay;
+            for(int t = 0; t < max_target; ++t)
+                conf[t][b] *= decay;
+        }
+
+        for(const auto& tx : txs)
+        {
+            auto it = tracked.find(tx.tx_id);
+            if(it == tracked.end())
+                continue; //never seen in our mempool
+            int blocks = max(1, height - it->second.first);
+            int bucket = it->second.second;
+            untrack(it);
+            tx_count[bucket] += 1;
+            fee_sum[bucket] += fee_rate(tx);
+            for(int t = blocks - 1; t < max_target; ++t)
+                conf[t][bucket] += 1;
+        }
+    }
+
+    //lowest fee rate that confirmed within target blocks often enough, -1 if there is no data
+    //walks buckets from the highest rate down, O(buckets * max_target) with max_target fixed
+    double estimate_fee_rate(int target) const
+    {
+        if(target < 1)
+            target = 1;
+        if(target > max_target)
+            target = max_target;
+
+        //slots whose entries have already waited at least target blocks
+        vector<int> late_slots;
+        for(int s = 0; s < max_target; ++s)
+        {
+            int age = ((best_height - s) % max_target + max_target) % max_target;
+            if(age >= target)
+                late_slots.push_back(s);
+        }
+
+        double n_conf = 0, n_total = 0, n_fail = 0, rate_sum = 0;
+        double best = -1;
+        for(int b = (int)bounds.size() - 1; b >= 0; --b)
+        {
+            n_conf += conf[target - 1][b];
+            n_total += tx_count[b];
+            rate_sum += fee_sum[b];
+            n_fail += old_unconf[b];
+            for(int s : late_slots)
+                n_fail += unconf[s][b];
+            if(n_total + n_fail < min_data)
+                continue;
+            if(n_total > 0 && n_conf / (n_total + n_fail) >= success_threshold)
+            {
+                best = rate_sum / n_total;
+                n_conf = n_total = n_fail = rate_sum = 0;
+            }
+            else
+                break;
+        }
+        return best;
+    }
+
+    //fee this transaction would need to confirm within target blocks, -1 if there is no data
+    double estimate_fee(const Transaction& tx, int target) const
+    {
+        double rate = estimate_fee_rate(target);
+        return rate < 0 ? -1 : rate * tx_size(tx);
+    }
+
+    void display_estimates() const
+    {
+        cout << "\n--- Fee Estimates ---" << endl;
+        cout << left << setw(12) << "Target" << setw(20) << "BTC/byte" << endl;
+        int targets[] = {1, 2, 3, 6, 12};
+        for(int t : targets)
+        {
+            if(t > max_target)
+                break;
+            double rate = estimate_fee_rate(t);
+            cout << left << setw(12) << (to_string(t) + " blocks");
+            if(rate < 0)
+                cout << "no data" << endl;
+            else
+                cout << scientific << setprecision(3) << rate << defaultfloat << endl;
+        }
+    }
+
+    //confirmed-tx histograms survive restarts, pending mempool tracking does not
+    bool save(const string& path) const
+    {
+        ofstream out(path);
+        if(!out)
+            return false;
+        out << "fee_estimator 1\n";
+        out << setprecision(17) << min_rate << " " << spacing << " " << max_target << " " << decay << " " << bounds.size() << "\n";
+        for(size_t b = 0; b < bounds.size(); ++b)
+            out << bounds[b] << " " << tx_count[b] << " " << fee_sum[b] << "\n";
+        for(int t = 0; t < max_target; ++t)
+        {
+            for(size_t b = 0; b < bounds.size(); ++b)
+                out << conf[t][b] << (b + 1 < bounds.size() ? " " : "\n");
+        }
+        return (bool)out;
+    }
+
+    //rejects files whose parameters bucket_of() cannot use or whose bounds do not follow
+    //from min_rate and spacing; the current state is kept then
+    bool load(const string& path)
+    {
+        ifstream in(path);
+        string magic;
+        int version;
+        if(!(in >> magic >> version) || magic != "fee_estimator" || version != 1)
+            return false;
+        double new_min, new_spacing, new_decay;
+        int new_target;
+        size_t n;
+        if(!(in >> new_min >> new_spacing >> new_target >> new_decay >> n) || new_target < 1 || n == 0)
+            return false;
+        if(!isfinite(new_min) || new_min <= 0 || !isfinite(new_spacing) || new_spacing <= 1 || !(new_decay > 0 && new_decay <= 1))
+            return false;
+        vector<double> new_bounds(n), new_count(n), new_sum(n);
+        vector<vector<double>> new_conf(new_target, vector<double>(n));
+        for(size_t b = 0; b < n; ++b)
+            in >> new_bounds[b] >> new_count[b] >> new_sum[b];
+        for(int t = 0; t < new_target; ++t)
+            for(size_t b = 0; b < n; ++b)
+                in >> new_conf[t][b];
+        if(!in)
+            return false;
+        for(size_t b = 0; b < n; ++b)
+        {
+            double expected = new_min * pow(new_spacing, (double)b);
+            if(!isfinite(expected) || fabs(new_bounds[b] - expected) > expected * 1e-9)
+                return false;
+        }
+        min_rate = new_min;
+        spacing = new_spacing;
+        max_target = new_target;
+        decay = new_decay;
+        bounds = new_bounds;
+        tx_count = new_count;
+        fee_sum = new_sum;
+        conf = new_conf;
+        best_height = 0;
+        reset_unconfirmed();
+        return true;
+    }
+};
+
+#endif
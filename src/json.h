@@ -0,0 +1,413 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include<bits/stdc++.h>
+#include<charconv>
+using namespace std;
+
+//small JSON value with a recursive-descent parser and a compact writer
+//objects keep insertion order; numbers are doubles
+struct Json
+{
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0;
+    string text;
+    vector<Json> items; //array elements
+    vector<pair<string, Json>> members; //object members
+
+    Json() {}
+    Json(bool b) : type(Bool), boolean(b) {}
+    Json(int n) : type(Number), number(n) {}
+    Json(int64_t n) : type(Number), number((double)n) {}
+    Json(size_t n) : type(Number), number((double)n) {}
+    Json(double n) : type(Number), number(n) {}
+    Json(const char* s) : type(String), text(s) {}
+    Json(string s) : type(String), text(move(s)) {}
+
+    static Json array()
+    {
+        Json j;
+        j.type = Array;
+        return j;
+    }
+
+    static Json object()
+    {
+        Json j;
+        j.type = Object;
+        return j;
+    }
+
+    bool is_null() const { return type == Null; }
+    bool is_number() const { return type == Number; }
+    bool is_string() const { return type == String; }
+    bool is_array() const { return type == Array; }
+    bool is_object() const { return type == Object; }
+
+    Json& push(Json value)
+    {
+        items.push_back(move(value));
+        return *this;
+    }
+
+    Json& set(string key, Json value)
+    {
+        for(auto& m : members)
+        {
+            if(m.first == key)
+            {
+                m.second = move(value);
+                return *this;
+            }
+        }
+        members.push_back({move(key), move(value)});
+        return *this;
+    }
+
+    //member lookup, nullptr if absent or not an object
+    const Json* get(string_view key) const
+    {
+        for(const auto& m : members)
+        {
+            if(m.first == key)
+                return &m.second;
+        }
+        return nullptr;
+    }
+
+    void dump(string& out) const
+    {
+        switch(type)
+        {
+        case Null:
+            out += "null";
+            break;
+        case Bool:
+            out += boolean ? "true" : "false";
+            break;
+        case Number:
+            dump_number(number, out);
+            break;
+        case String:
+            dump_string(text, out);
+            break;
+        case Array:
+            out += '[';
+            for(size_t i = 0; i < items.size(); ++i)
+            {
+                if(i)
+                    out += ',';
+                items[i].dump(out);
+            }
+            out += ']';
+            break;
+        case Object:
+            out += '{';
+            for(size_t i = 0; i < members.size(); ++i)
+            {
+                if(i)
+                    out += ',';
+                dump_string(members[i].first, out);
+                out += ':';
+                members[i].second.dump(out);
+            }
+            out += '}';
+            break;
+        }
+    }
+
+    string dump() const
+    {
+        string out;
+        dump(out);
+        return out;
+    }
+
+    //integers print without a fraction, anything else in the shortest form that reads back
+    //as the same double
+    static void dump_number(double number, string& out)
+    {
+        char buf[32];
+        if(!isfinite(number))
+            out += "null";
+        else if(number == floor(number) && fabs(number) < 9e15)
+            out.append(buf, to_chars(buf, buf + sizeof(buf), (long long)number).ptr);
+        else
+            out.append(buf, to_chars(buf, buf + sizeof(buf), number).ptr);
+    }
+
+    static void dump_string(string_view s, string& out)
+    {
+        static const char* hex = "0123456789abcdef";
+        out += '"';
+        for(unsigned char c : s)
+        {
+            switch(c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if(c < 0x20)
+                {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 15];
+                }
+                else
+                    out += (char)c;
+            }
+        }
+        out += '"';
+    }
+
+    //parses a complete document, false with a message on malformed input
+    static bool parse(string_view in, Json& out, string& error)
+    {
+        size_t pos = 0;
+        if(!parse_value(in, pos, out, error, 0))
+            return false;
+        skip_space(in, pos);
+        if(pos != in.size())
+        {
+            error = "Trailing characters at offset " + to_string(pos);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const int MAX_DEPTH = 64;
+
+    static void skip_space(string_view in, size_t& pos)
+    {
+        while(pos < in.size() && (in[pos] == ' ' || in[pos] == '\t' || in[pos] == '\n' || in[pos] == '\r'))
+            pos++;
+    }
+
+    static bool fail(string& error, const string& what, size_t pos)
+    {
+        error = what + " at offset " + to_string(pos);
+        return false;
+    }
+
+    static void append_utf8(string& out, uint32_t cp)
+    {
+        if(cp < 0x80)
+            out += (char)cp;
+        else if(cp < 0x800)
+        {
+            out += (char)(0xc0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3f));
+        }
+        else if(cp < 0x10000)
+        {
+            out += (char)(0xe0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3f));
+            out += (char)(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            out += (char)(0xf0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3f));
+            out += (char)(0x80 | ((cp >> 6) & 0x3f));
+            out += (char)(0x80 | (cp & 0x3f));
+        }
+    }
+
+    static bool parse_hex4(string_view in, size_t& pos, uint32_t& cp)
+    {
+        if(pos + 4 > in.size())
+            return false;
+        cp = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            char c = in[pos++];
+            cp <<= 4;
+            if(c >= '0' && c <= '9') cp |= c - '0';
+            else if(c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    static bool parse_string(string_view in, size_t& pos, string& out, string& error)
+    {
+        pos++; //opening quote
+        while(pos < in.size())
+        {
+            char c = in[pos++];
+            if(c == '"')
+                return true;
+            if((unsigned char)c < 0x20)
+                return fail(error, "Control character in string", pos - 1);
+            if(c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if(pos >= in.size())
+                break;
+            char e = in[pos++];
+            switch(e)
+            {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                uint32_t cp;
+                if(!parse_hex4(in, pos, cp))
+                    return fail(error, "Bad \\u escape", pos);
+                if(cp >= 0xd800 && cp < 0xdc00 && pos + 1 < in.size() && in[pos] == '\\' && in[pos + 1] == 'u')
+                {
+                    size_t save = pos;
+                    pos += 2;
+                    uint32_t low;
+                    if(parse_hex4(in, pos, low) && low >= 0xdc00 && low < 0xe000)
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    else
+                        pos = save;
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return fail(error, "Bad escape", pos - 1);
+            }
+        }
+        return fail(error, "Unterminated string", pos);
+    }
+
+    static bool parse_value(string_view in, size_t& pos, Json& out, string& error, int depth)
+    {
+        if(depth > MAX_DEPTH)
+            return fail(error, "Nesting too deep", pos);
+        skip_space(in, pos);
+        if(pos >= in.size())
+            return fail(error, "Unexpected end of input", pos);
+        char c = in[pos];
+        if(c == '{')
+        {
+            out = object();
+            pos++;
+            skip_space(in, pos);
+            if(pos < in.size() && in[pos] == '}')
+            {
+                pos++;
+                return true;
+            }
+            while(true)
+            {
+                skip_space(in, pos);
+                if(pos >= in.size() || in[pos] != '"')
+                    return fail(error, "Expected member name", pos);
+                string key;
+                if(!parse_string(in, pos, key, error))
+                    return false;
+                skip_space(in, pos);
+                if(pos >= in.size() || in[pos] != ':')
+                    return fail(error, "Expected ':'", pos);
+                pos++;
+                Json value;
+                if(!parse_value(in, pos, value, error, depth + 1))
+                    return false;
+                out.members.push_back({move(key), move(value)});
+                skip_space(in, pos);
+                if(pos < in.size() && in[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                if(pos < in.size() && in[pos] == '}')
+                {
+                    pos++;
+                    return true;
+                }
+                return fail(error, "Expected ',' or '}'", pos);
+            }
+        }
+        if(c == '[')
+        {
+            out = array();
+            pos++;
+            skip_space(in, pos);
+            if(pos < in.size() && in[pos] == ']')
+            {
+                pos++;
+                return true;
+            }
+            while(true)
+            {
+                Json value;
+                if(!parse_value(in, pos, value, error, depth + 1))
+                    return false;
+                out.items.push_back(move(value));
+                skip_space(in, pos);
+                if(pos < in.size() && in[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                if(pos < in.size() && in[pos] == ']')
+                {
+                    pos++;
+                    return true;
+                }
+                return fail(error, "Expected ',' or ']'", pos);
+            }
+        }
+        if(c == '"')
+        {
+            out = Json(string());
+            return parse_string(in, pos, out.text, error);
+        }
+        if(in.substr(pos, 4) == "true")
+        {
+            out = Json(true);
+            pos += 4;
+            return true;
+        }
+        if(in.substr(pos, 5) == "false")
+        {
+            out = Json(false);
+            pos += 5;
+            return true;
+        }
+        if(in.substr(pos, 4) == "null")
+        {
+            out = Json();
+            pos += 4;
+            return true;
+        }
+        if(c == '-' || (c >= '0' && c <= '9'))
+        {
+            size_t start = pos;
+            if(in[pos] == '-')
+                pos++;
+            while(pos < in.size() && (isdigit((unsigned char)in[pos]) || in[pos] == '.' || in[pos] == 'e' || in[pos] == 'E' || in[pos] == '+' || in[pos] == '-'))
+                pos++;
+            string num(in.substr(start, pos - start));
+            char* end = nullptr;
+            double v = strtod(num.c_str(), &end);
+            if(end != num.c_str() + num.size())
+                return fail(error, "Bad number", start);
+            out = Json(v);
+            return true;
+        }
+        return fail(error, "Unexpected character", pos);
+    }
+};
+
+#endif
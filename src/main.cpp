@@ -1,9 +1,114 @@
 #include<bits/stdc++.h>
+#include<csignal>
 #include "simulator.h"
 
-int main() {
+static RpcServer* rpc_server = nullptr;
 
-    Simulator sim(0.01, 6.25, 5, 2);
-    sim.run();
+static void stop_server(int)
+{
+    if(rpc_server)
+        rpc_server->stop();
+}
+
+static int usage(const string& error)
+{
+    cout << error << endl;
+    cout << "Usage: simulator [--rpc-port PORT] [--rpc-socket PATH] [--record PATH] [--replay PATH] [--seed N] [--stress SEED]" << endl;
+    return 1;
+}
+
+// the whole of text as a decimal number no larger than max
+static bool parse_number(const char* text, uint64_t max, uint64_t& out)
+{
+    if (!isdigit((unsigned char)text[0]))
+        return false;
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long v = strtoull(text, &end, 10);
+    if (errno == ERANGE || *end != '\0' || v > max)
+        return false;
+    out = v;
+    return true;
+}
+
+// --rpc-port N and/or --rpc-socket PATH start the JSON-RPC server instead of the menu
+// --record PATH logs the run's events, --replay PATH re-executes such a log and checks it
+// --seed N fixes the transaction id RNG, --stress SEED runs the randomized stress suite
+int main(int argc, char** argv) {
+
+    int rpc_port = -1;
+    string rpc_socket, record_path, replay_path;
+    uint64_t seed = 0, stress_seed = 0;
+    for (int i = 1; i < argc; i += 2) {
+        string flag = argv[i];
+        if (i + 1 == argc)
+            return usage("Missing value for " + flag);
+        const char* value = argv[i + 1];
+        uint64_t port;
+        if (flag == "--rpc-port") {
+            if (!parse_number(value, 65535, port))
+                return usage("Invalid port for --rpc-port: " + string(value) + " (expected 0-65535)");
+            rpc_port = (int)port;
+        }
+        else if (flag == "--rpc-socket")
+            rpc_socket = value;
+        else if (flag == "--record")
+            record_path = value;
+        else if (flag == "--replay")
+            replay_path = value;
+        else if (flag == "--seed") {
+            if (!parse_number(value, UINT64_MAX, seed))
+                return usage("Invalid number for --seed: " + string(value));
+        }
+        else if (flag == "--stress") {
+            if (!parse_number(value, UINT64_MAX, stress_seed))
+                return usage("Invalid number for --stress: " + string(value));
+        }
+        else
+            return usage("Unknown option: " + flag);
+    }
+
+    if (stress_seed)
+        return run_stress_suite(stress_seed) ? 0 : 1;
+
+    if (!replay_path.empty()) {
+        ReplayStats stats = {};
+        auto result = Simulator::replay(replay_path, &stats);
+        cout << result.second << endl;
+        cout << "Replayed " << stats.events << " events in " << fixed << setprecision(1) << stats.elapsed_ms << " ms" << endl;
+        return result.first ? 0 : 1;
+    }
+
+    Simulator sim(0.01, 6.25, 5, 2, 1 << 20, 3600, seed);
+    if (!sim.use_fee_estimates("fee_estimates.dat"))
+        cout << "Ignoring unreadable fee_estimates.dat" << endl;
+    if (!record_path.empty()) {
+        auto result = sim.start_recording(record_path);
+        cout << result.second << endl;
+        if (!result.first)
+            return 1;
+    }
+    if (rpc_port < 0 && rpc_socket.empty()) {
+        sim.run();
+        sim.stop_recording();
+        return 0;
+    }
+
+    RpcServer server;
+    vector<pair<bool, string>> listening;
+    if (rpc_port >= 0)
+        listening.push_back(server.listen_tcp(rpc_port));
+    if (!rpc_socket.empty())
+        listening.push_back(server.listen_unix(rpc_socket));
+    for (const auto& result : listening) {
+        cout << result.second << endl;
+        if (!result.first)
+            return 1;
+    }
+    rpc_server = &server;
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+    sim.serve(server);
+    sim.stop_recording();
     return 0;
-}
\ No newline at end of file
+}
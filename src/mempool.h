@@ -1,27 +1,124 @@
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
 #include<bits/stdc++.h>
 #include"transaction.h"
+#include"signatures.h"
+#include"fee_estimator.h"
+#include"timer_wheel.h"
+#include"policies.h"
 using namespace std;
 
-class Mempool 
+//Selection orders transactions for mining, Fee sets the minimum fee; both limits evict by fee rate
+template<typename Selection = SelectByFee, typename Fee = PercentageFee>
+class BasicMempool 
 {
 public:
     vector<Transaction> transactions;
-    set<pair<string, int>> spent_utxos;
+    unordered_map<pair<string, int>, string, OutpointHash> spent_utxos; //outpoint -> tx_id of the mempool tx spending it
     int max_size;
     double gas_fee;
-    Mempool(int max_size = 5, double gas_fee = 0.01)
+    SignatureVerifier* verifier = nullptr; //when set, inputs must be signed by their owners
+    FeeEstimator* fee_estimator = nullptr; //when set, told about admissions and evictions
+
+    //replace-by-fee: a conflicting transaction may replace the ones it conflicts with
+    //(and their descendants) if it pays more than all of them together
+    bool replace_by_fee = false;
+    size_t max_replacements = 100;
+
+    //memory budget: 0 means only max_size applies
+    size_t max_bytes;
+    size_t total_bytes = 0; //tx_memory_usage() of every resident transaction
+    multiset<pair<double, string>> by_fee_rate; //(fee rate, tx_id), cheapest first
+
+    //rolling minimum fee rate, raised by evictions and halving every min_fee_half_life seconds
+    //of current_time(), so a replay with the recorded clock decays it the same way
+    double incremental_fee_rate = 1e-7;
+    double min_fee_half_life = 600;
+    double rolling_min_fee_rate = 0;
+    int64_t min_fee_updated = 0; //current_time() when rolling_min_fee_rate was last set
+
+    //expiry: entries older than expiry_seconds are dropped by expire(), 0 keeps them forever
+    int64_t expiry_seconds;
+    unordered_map<string, int64_t> entry_time; //tx_id -> admission time (seconds)
+    unordered_map<string, size_t> position; //tx_id -> index in transactions
+    TimerWheel<string> expiry_wheel;
+    function<int64_t()> clock; //seconds for admission times and expire(), steady clock if unset
+
+    BasicMempool(int max_size = 5, double gas_fee = 0.01, size_t max_bytes = 0, int64_t expiry_seconds = 0)
+        : expiry_wheel(now_seconds())
     {
         this->max_size = max_size; //default maxsize
         this->gas_fee = gas_fee;
+        this->max_bytes = max_bytes;
+        this->expiry_seconds = expiry_seconds;
+    }
+
+    static int64_t now_seconds()
+    {
+        return chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    int64_t current_time() const
+    {
+        return clock ? clock() : now_seconds();
+    }
+
+    //digest of the resident transactions in pool order, signatures not included
+    crypto::SetHash state_hash() const
+    {
+        crypto::Sha512 h;
+        for(const auto& tx : transactions)
+        {
+            crypto::Digest d = transaction_digest(tx);
+            h.update(d.data(), d.size());
+        }
+        crypto::Digest d = h.final();
+        crypto::SetHash out;
+        memcpy(out.data(), d.data(), out.size());
+        return out;
+    }
+
+    //current admission floor in BTC per byte
+    double min_fee_rate()
+    {
+        if(rolling_min_fee_rate == 0)
+            return 0;
+        int64_t now = current_time();
+        if(now > min_fee_updated)
+        {
+            rolling_min_fee_rate *= pow(0.5, (now - min_fee_updated) / min_fee_half_life);
+            min_fee_updated = now;
+        }
+        if(rolling_min_fee_rate < incremental_fee_rate / 2)
+            rolling_min_fee_rate = 0;
+        return rolling_min_fee_rate;
+    }
+
+    size_t memory_usage() const
+    {
+        return total_bytes;
+    }
+
+    bool over_limits() const
+    {
+        return (max_size > 0 && transactions.size() > (size_t)max_size) || (max_bytes > 0 && total_bytes > max_bytes);
     }
 
     //add transaction to mempool
-    pair<bool, string> add_transaction(Transaction tx, UTXOManager& utxo_manager) 
+    template<typename UTXOSet>
+    pair<bool, string> add_transaction(Transaction tx, UTXOSet& utxo_manager) 
     {
+        // is this tx_id already pooled? position, by_fee_rate and spent_utxos are keyed by it
+        if(position.count(tx.tx_id))
+        {
+            return {false, "Transaction already in mempool: " + tx.tx_id};
+        }
 
         // Validation 1: Inputs exist in UTXO set
         double total_input = 0;
         set<pair<string, int>> tx_inputs;
+        unordered_set<string> conflicts; // mempool txs spending the same outpoints
         for (const auto& input : tx.inputs) 
         {
             // does utxo exists?
@@ -39,12 +136,15 @@ public:
             tx_inputs.insert({input.prev_tx_id, input.index});
             
             // am i using a spent utxo?
-            if(spent_utxos.count({input.prev_tx_id, input.index})) 
+            auto spender = spent_utxos.find({input.prev_tx_id, input.index});
+            if(spender != spent_utxos.end()) 
             {
-                return {false, "UTXO already spent in mempool: " + input.prev_tx_id + ":" + to_string(input.index)};
+                if(!replace_by_fee)
+                    return {false, "UTXO already spent in mempool: " + input.prev_tx_id + ":" + to_string(input.index)};
+                conflicts.insert(spender->second);
             }
 
-            total_input += utxo_manager.utxo_set[{input.prev_tx_id, input.index}].amount;
+            total_input += utxo_manager.find_utxo(input.prev_tx_id, input.index)->amount;
         }
 
         double total_output = 0;
@@ -61,68 +161,271 @@ public:
         }
 
         tx.fee = - total_output + total_input;
+        if constexpr (Fee::has_minimum)
+        {
+            if(tx.fee + 1e-9 < Fee::minimum(tx, gas_fee))
+                return {false, "Fee " + to_string(tx.fee) + " below required " + to_string(Fee::minimum(tx, gas_fee))};
+        }
         // tx.fee = total_output*gas_fee;
         // if(total_input == total_output)
         // tx.fee = 0;
 
-        transactions.push_back(tx);
+        // does it pay the rolling minimum? checked before the expensive signature work
+        double rate = fee_rate(tx);
+        double floor_rate = min_fee_rate();
+        if(floor_rate > 0 && rate < floor_rate)
+        {
+            return {false, "Fee rate " + to_string(rate) + " below mempool minimum " + to_string(floor_rate)};
+        }
+
+        // does it pay enough to replace everything it conflicts with?
+        vector<string> replaced;
+        if(!conflicts.empty())
+        {
+            auto rbf_check = check_replacement(tx, conflicts, replaced);
+            if(!rbf_check.first)
+                return rbf_check;
+        }
+
+        // is every input signed by the owner of the utxo?
+        if(verifier)
+        {
+            auto sig_check = verifier->check_transaction(tx, utxo_manager);
+            if(!sig_check.first)
+                return sig_check;
+        }
+
+        for(const auto& id : replaced)
+        {
+            cout<<"Transaction "<<id<<" has been replaced by "<<tx.tx_id<<"."<<endl;
+            remove_transaction(id);
+            if(fee_estimator)
+                fee_estimator->remove_transaction(id);
+        }
+
+        position[tx.tx_id] = transactions.size();
+        int64_t now = current_time();
+        entry_time[tx.tx_id] = now;
+        if(expiry_seconds > 0)
+            expiry_wheel.schedule(tx.tx_id, now + expiry_seconds);
+        total_bytes += tx_memory_usage(tx);
+        by_fee_rate.insert({rate, tx.tx_id});
+        if(fee_estimator)
+            fee_estimator->process_transaction(tx);
 
         for (const auto& input : tx.inputs) 
         {
-            spent_utxos.insert({input.prev_tx_id, input.index});
+            spent_utxos[{input.prev_tx_id, input.index}] = tx.tx_id;
         }
-        if(transactions.size() > max_size)
+        string tx_id = tx.tx_id;
+        double fee = tx.fee;
+        transactions.push_back(move(tx));
+
+        // over the count limit or the memory budget: drop the lowest fee rates (the newcomer
+        // first among equals) and raise the floor above each evicted rate
+        bool self_evicted = false;
+        while(over_limits() && !by_fee_rate.empty())
         {
-            vector<Transaction> temp_transaction = transactions; 
-            transactions = get_top_transactions(max_size);
-            cout<<"Mempool transaction limit exceeded."<<endl;
-            for(Transaction txn : temp_transaction)
+            auto cheapest = *by_fee_rate.begin();
+            string victim = cheapest.second;
+            if(!self_evicted && cheapest.first >= rate)
+                victim = tx_id;
+            if(victim == tx_id)
+                self_evicted = true;
+            rolling_min_fee_rate = max(min_fee_rate(), cheapest.first + incremental_fee_rate);
+            min_fee_updated = current_time();
+            evict(victim);
+        }
+        if(self_evicted)
+            return {false, "Mempool is full"};
+
+        if(!replaced.empty())
+            return {true, "Transaction valid! Fee: " + to_string(fee) + " (replaced " + to_string(replaced.size()) + " transactions)"};
+        return {true, "Transaction valid! Fee: " + to_string(fee)};
+    }
+
+    //collects the conflicting transactions plus their in-mempool descendants into replaced
+    //and checks the replacement pays for all of them and for its own relay
+    pair<bool, string> check_replacement(const Transaction& tx, const unordered_set<string>& conflicts, vector<string>& replaced)
+    {
+        double replaced_fees = 0;
+        double max_conflict_rate = 0;
+        unordered_set<string> seen(conflicts.begin(), conflicts.end());
+        replaced.assign(conflicts.begin(), conflicts.end());
+        for(size_t i = 0; i < replaced.size(); ++i)
+        {
+            auto pos = position.find(replaced[i]);
+            if(pos == position.end())
+                continue;
+            const Transaction& victim = transactions[pos->second];
+            replaced_fees += victim.fee;
+            if(conflicts.count(victim.tx_id))
+                max_conflict_rate = max(max_conflict_rate, fee_rate(victim));
+            // descendants spend this transaction's outputs
+            for(size_t out = 0; out < victim.outputs.size(); ++out)
             {
-                if(find(transactions.begin(), transactions.end(), txn) == transactions.end())
-                {
-                    spent_utxos.erase({txn.inputs.front().prev_tx_id, txn.inputs.front().index});
-                    cout<<"Transaction "<<txn.tx_id<<" has been evicted from the mempool."<<endl;
-                }
+                auto child = spent_utxos.find({victim.tx_id, (int)out});
+                if(child != spent_utxos.end() && seen.insert(child->second).second)
+                    replaced.push_back(child->second);
             }
-            return {false, "Mempool is full"};
+            if(replaced.size() > max_replacements)
+                return {false, "Replacement would evict more than " + to_string(max_replacements) + " transactions"};
+        }
+
+        if(fee_rate(tx) <= max_conflict_rate)
+            return {false, "Replacement fee rate " + to_string(fee_rate(tx)) + " does not exceed conflicting fee rate " + to_string(max_conflict_rate)};
+        double required = replaced_fees + incremental_fee_rate * tx_size(tx);
+        if(tx.fee < required)
+            return {false, "Replacement fee " + to_string(tx.fee) + " does not cover replaced fees " + to_string(replaced_fees) + " plus relay increment"};
+        return {true, ""};
+    }
+
+    void remove_transaction(const string& tx_id) 
+    {
+        take_transaction(tx_id, nullptr);
+    }
+
+    //removes a transaction and, if out is given, moves it there instead of destroying it
+    bool take_transaction(const string& tx_id, Transaction* out)
+    {
+        auto pos = position.find(tx_id);
+        if (pos == position.end())
+            return false;
+        size_t i = pos->second;
+        Transaction& tx = transactions[i];
+        for (const auto& input : tx.inputs) 
+        {
+            spent_utxos.erase({input.prev_tx_id, input.index});
+        }
+        total_bytes -= tx_memory_usage(tx);
+        auto ranked = by_fee_rate.find({fee_rate(tx), tx.tx_id});
+        if (ranked != by_fee_rate.end())
+            by_fee_rate.erase(ranked);
+        entry_time.erase(tx.tx_id);
+        position.erase(pos);
+        if (out)
+            *out = move(tx);
+        // swap with the last entry so removal is O(1)
+        if (i + 1 != transactions.size())
+        {
+            transactions[i] = move(transactions.back());
+            position[transactions[i].tx_id] = i;
         }
+        transactions.pop_back();
+        return true;
+    }
 
-        return {true, "Transaction valid! Fee: " + to_string(tx.fee)};
+    //removal for policy reasons (limits), tells the fee estimator it was not confirmed
+    void evict(const string& tx_id)
+    {
+        cout<<"Transaction "<<tx_id<<" has been evicted from the mempool."<<endl;
+        remove_transaction(tx_id);
+        if(fee_estimator)
+            fee_estimator->remove_transaction(tx_id);
     }
 
-    void remove_transaction(string tx_id) 
+    //drops entries that have waited expiry_seconds, releasing their inputs
+    //only the timers that came due are looked at, not the whole pool
+    int expire(int64_t now)
     {
-        for (auto it = transactions.begin(); it != transactions.end(); ++it) 
+        vector<string> due;
+        expiry_wheel.advance(now, due);
+        int expired = 0;
+        for(const auto& id : due)
         {
-            if (it->tx_id == tx_id) 
+            auto it = entry_time.find(id);
+            if(it == entry_time.end() || it->second + expiry_seconds > now)
+                continue; //mined or removed since, or re-admitted later
+            cout<<"Transaction "<<id<<" has expired from the mempool."<<endl;
+            remove_transaction(id);
+            if(fee_estimator)
+                fee_estimator->remove_transaction(id);
+            expired++;
+        }
+        return expired;
+    }
+
+    int expire()
+    {
+        return expire(current_time());
+    }
+
+    //drops transactions whose inputs are no longer in the UTXO set (e.g. after a reorg)
+    template<typename UTXOSet>
+    int remove_invalid(UTXOSet& utxo_manager)
+    {
+        vector<string> stale;
+        for(const auto& tx : transactions)
+        {
+            for(const auto& input : tx.inputs)
             {
-                for (const auto& input : it->inputs) 
+                if(!utxo_manager.exists(input.prev_tx_id, input.index))
                 {
-                    spent_utxos.erase({input.prev_tx_id, input.index});
+                    stale.push_back(tx.tx_id);
+                    break;
                 }
-                transactions.erase(it);
-                return;
             }
         }
+        for(const auto& id : stale)
+        {
+            remove_transaction(id);
+            if(fee_estimator)
+                fee_estimator->remove_transaction(id);
+        }
+        return stale.size();
     }
 
-    vector<Transaction> get_top_transactions(int n) 
+    //sorts pointers rather than copies, then copies only the n it returns
+    vector<const Transaction*> top_entries(int n) const
     {
-        vector<Transaction> sorted_txs = transactions;
-        sort(sorted_txs.begin(), sorted_txs.end(), [](const Transaction& a, const Transaction& b) {
-            return a.fee > b.fee; //high fee priority
+        vector<const Transaction*> order;
+        order.reserve(transactions.size());
+        for(const auto& tx : transactions)
+            order.push_back(&tx);
+        sort(order.begin(), order.end(), [](const Transaction* a, const Transaction* b) {
+            return Selection::before(*a, *b); //high fee priority by default
         });
-        if(sorted_txs.size() > n) 
+        if(order.size() > n) 
         {
-            sorted_txs.resize(n);
+            order.resize(n);
         }
-        return sorted_txs;
+        return order;
+    }
+
+    vector<Transaction> get_top_transactions(int n) const
+    {
+        vector<Transaction> top;
+        for(const Transaction* tx : top_entries(n))
+            top.push_back(*tx);
+        return top;
+    }
+
+    //removes the top n transactions and moves them out, for mining; only transactions
+    //actually taken out of the pool are returned
+    vector<Transaction> take_top_transactions(int n)
+    {
+        vector<string> ids;
+        for(const Transaction* tx : top_entries(n))
+            ids.push_back(tx->tx_id);
+        vector<Transaction> top;
+        top.reserve(ids.size());
+        Transaction taken;
+        for(const auto& id : ids)
+        {
+            if(take_transaction(id, &taken))
+                top.push_back(move(taken));
+        }
+        return top;
     }
 
     void clear() //clear mempool
     {
         transactions.clear();
         spent_utxos.clear();
+        by_fee_rate.clear();
+        total_bytes = 0;
+        entry_time.clear();
+        position.clear();
     }
 
     void display() 
@@ -140,3 +443,7 @@ public:
         }
     }
 };
+
+typedef BasicMempool<> Mempool;
+
+#endif
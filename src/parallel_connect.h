@@ -0,0 +1,339 @@
+#ifndef PARALLEL_CONNECT_H
+#define PARALLEL_CONNECT_H
+
+#include<bits/stdc++.h>
+#include"block.h"
+using namespace std;
+
+//UTXO set split into independently locked hash shards; each shard keeps its own MuHash,
+//and since MuHash is a product the shard hashes combine into the hash of the whole set
+class ConcurrentUTXOSet
+{
+    struct Shard
+    {
+        mutable mutex lock;
+        unordered_map<pair<string, int>, UTXO, OutpointHash> utxos;
+        crypto::MuHash hash;
+    };
+
+    vector<unique_ptr<Shard>> shards;
+
+    Shard& shard_for(const string& tx_id, int index) const
+    {
+        return *shards[OutpointHash()(pair<string_view, int>(tx_id, index)) % shards.size()];
+    }
+
+    static void hash_insert(Shard& s, const UTXO& u)
+    {
+        string c = UTXOManager::utxo_commitment(u);
+        s.hash.insert((const uint8_t*)c.data(), c.size());
+    }
+
+    static void hash_remove(Shard& s, const UTXO& u)
+    {
+        string c = UTXOManager::utxo_commitment(u);
+        s.hash.remove((const uint8_t*)c.data(), c.size());
+    }
+
+public:
+    ConcurrentUTXOSet(size_t num_shards = 64)
+    {
+        for(size_t i = 0; i < max<size_t>(num_shards, 1); ++i)
+            shards.emplace_back(new Shard());
+    }
+
+    ConcurrentUTXOSet(const UTXOManager& utxo_manager, size_t num_shards = 64) : ConcurrentUTXOSet(num_shards)
+    {
+        for(const auto& u : utxo_manager.utxo_set)
+            add_utxo(u.second.tx_id, u.second.index, u.second.amount, u.second.owner);
+    }
+
+    void add_utxo(const string& tx_id, int index, double amount, const string& owner)
+    {
+        Shard& s = shard_for(tx_id, index);
+        UTXO u = {tx_id, index, amount, owner};
+        lock_guard<mutex> guard(s.lock);
+        auto ins = s.utxos.insert({{tx_id, index}, u});
+        if(!ins.second)
+        {
+            hash_remove(s, ins.first->second);
+            ins.first->second = u;
+        }
+        hash_insert(s, u);
+    }
+
+    //removes the utxo and hands it back, false if it does not exist
+    bool take_utxo(const string& tx_id, int index, UTXO& out)
+    {
+        Shard& s = shard_for(tx_id, index);
+        lock_guard<mutex> guard(s.lock);
+        auto it = s.utxos.find({tx_id, index});
+        if(it == s.utxos.end())
+            return false;
+        out = move(it->second);
+        s.utxos.erase(it);
+        hash_remove(s, out);
+        return true;
+    }
+
+    void remove_utxo(const string& tx_id, int index)
+    {
+        UTXO ignored;
+        take_utxo(tx_id, index, ignored);
+    }
+
+    bool exists(const string& tx_id, int index) const
+    {
+        Shard& s = shard_for(tx_id, index);
+        lock_guard<mutex> guard(s.lock);
+        return s.utxos.count({tx_id, index}) > 0;
+    }
+
+    size_t size() const
+    {
+        size_t n = 0;
+        for(const auto& s : shards)
+        {
+            lock_guard<mutex> guard(s->lock);
+            n += s->utxos.size();
+        }
+        return n;
+    }
+
+    crypto::SetHash state_hash() const
+    {
+        crypto::MuHash total;
+        for(const auto& s : shards)
+        {
+            lock_guard<mutex> guard(s->lock);
+            total.combine(s->hash);
+        }
+        return total.finalize();
+    }
+
+    //copies the set into an ordered UTXOManager, e.g. to compare with serial application
+    UTXOManager to_manager() const
+    {
+        UTXOManager out;
+        for(const auto& s : shards)
+        {
+            lock_guard<mutex> guard(s->lock);
+            for(const auto& u : s->utxos)
+                out.add_utxo(u.second.tx_id, u.second.index, u.second.amount, u.second.owner);
+        }
+        return out;
+    }
+};
+
+struct ParallelConnectStats
+{
+    size_t groups; //independent groups of transactions
+    size_t largest_group;
+    int threads;
+};
+
+//splits a block's transactions into groups that touch disjoint outpoints: a transaction
+//joins the group of any in-block transaction whose outputs it spends, and of any other
+//transaction spending the same outpoint. Groups keep block order inside.
+vector<vector<int>> block_dependency_groups(const Block& block)
+{
+    int n = block.transactions.size();
+    vector<int> parent(n);
+    iota(parent.begin(), parent.end(), 0);
+    auto find = [&](int x) {
+        while(parent[x] != x)
+            x = parent[x] = parent[parent[x]];
+        return x;
+    };
+    auto unite = [&](int a, int b) {
+        a = find(a);
+        b = find(b);
+        if(a != b)
+            parent[max(a, b)] = min(a, b);
+    };
+
+    unordered_map<string, int> creator; //tx_id -> position of the tx creating its outputs
+    unordered_map<pair<string, int>, int, OutpointHash> spender; //outpoint -> first tx spending it
+    for(int i = 0; i < n; ++i)
+    {
+        auto ins = creator.insert({block.transactions[i].tx_id, i});
+        if(!ins.second)
+            unite(ins.first->second, i);
+    }
+    for(int i = 0; i < n; ++i)
+    {
+        for(const auto& input : block.transactions[i].inputs)
+        {
+            auto c = creator.find(input.prev_tx_id);
+            if(c != creator.end())
+                unite(c->second, i);
+            auto s = spender.insert({{input.prev_tx_id, input.index}, i});
+            if(!s.second)
+                unite(s.first->second, i);
+        }
+    }
+
+    vector<vector<int>> groups;
+    unordered_map<int, size_t> group_of;
+    for(int i = 0; i < n; ++i)
+    {
+        int root = find(i);
+        auto it = group_of.find(root);
+        if(it == group_of.end())
+        {
+            group_of[root] = groups.size();
+            groups.push_back({i});
+        }
+        else
+            groups[it->second].push_back(i);
+    }
+    return groups;
+}
+
+//the inputs a transaction has taken from the set so far, as the UTXO set SignatureVerifier
+//reads; an input not taken (missing from the set) is not found, as in the serial check
+struct TakenInputs
+{
+    const vector<UTXO>& utxos;
+
+    const UTXO* find_utxo(string_view tx_id, int index) const
+    {
+        for(const auto& u : utxos)
+        {
+            if(u.index == index && u.tx_id == tx_id)
+                return &u;
+        }
+        return nullptr;
+    }
+};
+
+//connects a block by applying its independent groups on several threads; each group is
+//applied in block order, so chained transactions still see their parents' outputs.
+//Like connect_block it refuses pruned blocks, checks a recorded Merkle root and UTXO hash,
+//and with a verifier checks every transaction's signatures (on the worker threads, the
+//verifier is thread safe). The result, including the error reported for an invalid block,
+//matches connect_block; on failure every group is rolled back and the set is unchanged.
+pair<bool, string> parallel_connect_block(const Block& block, ConcurrentUTXOSet& utxos, int num_threads = 0, ParallelConnectStats* stats = nullptr,
+                                          SignatureVerifier* verifier = nullptr)
+{
+    if(block.pruned)
+        return {false, "Block " + to_string(block.block_height) + " is pruned"};
+    if(block.has_merkle_root() && compute_merkle_root(block.transactions) != block.merkle_root)
+        return {false, "Block " + to_string(block.block_height) + ": Merkle root mismatch"};
+    vector<vector<int>> groups = block_dependency_groups(block);
+    if(num_threads <= 0)
+        num_threads = max(1u, thread::hardware_concurrency());
+    num_threads = max(1, min<int>(num_threads, groups.size()));
+
+    //per group: applied changes for rollback, and the position of its first failing tx
+    vector<vector<pair<bool, UTXO>>> applied(groups.size()); //(created?, utxo)
+    vector<int> failed_at(groups.size(), -1);
+    vector<string> failure(groups.size());
+
+    auto apply_group = [&](size_t g) {
+        vector<UTXO> taken;
+        for(int pos : groups[g])
+        {
+            const Transaction& tx = block.transactions[pos];
+            //inputs are taken first and checked after, so a missing one is reported by the
+            //verifier exactly where the serial check would report it
+            string missing;
+            taken.clear();
+            for(const auto& input : tx.inputs)
+            {
+                UTXO spent;
+                if(!utxos.take_utxo(input.prev_tx_id, input.index, spent))
+                {
+                    missing = "input UTXO does not exist: " + input.prev_tx_id + ":" + to_string(input.index);
+                    break;
+                }
+                if(verifier)
+                    taken.push_back(spent);
+                applied[g].push_back({false, move(spent)});
+            }
+            if(verifier)
+            {
+                auto sig_check = verifier->check_transaction(tx, TakenInputs{taken});
+                if(!sig_check.first)
+                {
+                    failed_at[g] = pos;
+                    failure[g] = tx.tx_id + ": " + sig_check.second;
+                    return;
+                }
+            }
+            if(!missing.empty())
+            {
+                failed_at[g] = pos;
+                failure[g] = missing;
+                return;
+            }
+            for(size_t i = 0; i < tx.outputs.size(); ++i)
+            {
+                utxos.add_utxo(tx.tx_id, i, tx.outputs[i].amount, tx.outputs[i].address);
+                applied[g].push_back({true, {tx.tx_id, (int)i, tx.outputs[i].amount, tx.outputs[i].address}});
+            }
+        }
+    };
+
+    //largest groups first so one long chain does not finish last
+    vector<size_t> order(groups.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return groups[a].size() > groups[b].size(); });
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while((i = next++) < order.size())
+            apply_group(order[i]);
+    };
+    vector<thread> workers;
+    for(int t = 1; t < num_threads; ++t)
+        workers.emplace_back(worker);
+    worker();
+    for(auto& w : workers)
+        w.join();
+
+    if(stats)
+    {
+        stats->groups = groups.size();
+        stats->largest_group = groups.empty() ? 0 : groups[order[0]].size();
+        stats->threads = num_threads;
+    }
+
+    auto rollback = [&]() {
+        for(auto& log : applied)
+        {
+            for(auto it = log.rbegin(); it != log.rend(); ++it)
+            {
+                if(it->first)
+                    utxos.remove_utxo(it->second.tx_id, it->second.index);
+                else
+                    utxos.add_utxo(it->second.tx_id, it->second.index, it->second.amount, it->second.owner);
+            }
+        }
+    };
+
+    //serial application stops at the earliest failing transaction
+    int first = -1;
+    for(size_t g = 0; g < groups.size(); ++g)
+    {
+        if(failed_at[g] >= 0 && (first < 0 || failed_at[g] < failed_at[first]))
+            first = g;
+    }
+    if(first >= 0)
+    {
+        rollback();
+        return {false, "Block " + to_string(block.block_height) + ": " + failure[first]};
+    }
+
+    string coinbase = coinbase_tx_id(block.block_height);
+    utxos.add_utxo(coinbase, 0, block.block_reward + block.total_fees, block.miner);
+    if(block.has_utxo_hash() && utxos.state_hash() != block.utxo_hash)
+    {
+        utxos.remove_utxo(coinbase, 0);
+        rollback();
+        return {false, "Block " + to_string(block.block_height) + ": UTXO set hash mismatch"};
+    }
+    return {true, "Block " + to_string(block.block_height) + " connected"};
+}
+
+#endif
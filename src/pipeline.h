@@ -0,0 +1,298 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include<bits/stdc++.h>
+#include"block.h"
+using namespace std;
+
+//bounded lock-free queue, many producers and one consumer
+//each cell carries a sequence number telling producers and the consumer whose turn it is
+template<typename T>
+class MPSCQueue
+{
+    struct Cell
+    {
+        atomic<size_t> sequence;
+        T data;
+    };
+
+    unique_ptr<Cell[]> buffer;
+    size_t mask;
+    alignas(64) atomic<size_t> enqueue_pos; //shared by producers
+    alignas(64) size_t dequeue_pos; //owned by the consumer
+
+public:
+    MPSCQueue(size_t capacity = 1024)
+    {
+        size_t size = 2;
+        while(size < capacity) //round up to a power of two
+            size <<= 1;
+        buffer.reset(new Cell[size]);
+        mask = size - 1;
+        for(size_t i = 0; i < size; ++i)
+            buffer[i].sequence.store(i, memory_order_relaxed);
+        enqueue_pos.store(0, memory_order_relaxed);
+        dequeue_pos = 0;
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    //returns false when the queue is full
+    bool try_push(T&& item)
+    {
+        size_t pos = enqueue_pos.load(memory_order_relaxed);
+        Cell* cell;
+        while(true)
+        {
+            cell = &buffer[pos & mask];
+            size_t seq = cell->sequence.load(memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if(diff == 0)
+            {
+                if(enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                    break;
+            }
+            else if(diff < 0)
+                return false; //consumer has not freed this cell yet
+            else
+                pos = enqueue_pos.load(memory_order_relaxed);
+        }
+        cell->data = move(item);
+        cell->sequence.store(pos + 1, memory_order_release);
+        return true;
+    }
+
+    //consumer side only
+    bool try_pop(T& item)
+    {
+        Cell* cell = &buffer[dequeue_pos & mask];
+        size_t seq = cell->sequence.load(memory_order_acquire);
+        if(seq != dequeue_pos + 1)
+            return false; //empty, or producer still writing
+        item = move(cell->data);
+        cell->sequence.store(dequeue_pos + mask + 1, memory_order_release);
+        dequeue_pos++;
+        return true;
+    }
+};
+
+//per stage counters, rates are per second since start()
+struct PipelineStats
+{
+    uint64_t submitted;
+    uint64_t rejected_full;
+    uint64_t admitted;
+    uint64_t rejected_invalid;
+    uint64_t batches;
+    uint64_t snapshots;
+    uint64_t blocks_mined;
+    uint64_t txs_mined;
+    double elapsed_seconds;
+    double ingest_rate;
+    double validate_rate;
+    double mine_rate;
+};
+
+//producers -> lock-free queue -> validator thread -> mempool
+//the validator publishes an immutable top-fee snapshot after every batch so
+//a miner can read it without taking the mempool lock
+class TxPipeline
+{
+    Mempool& mempool;
+    UTXOManager& utxo_manager;
+    MPSCQueue<Transaction> queue;
+    mutex state_mutex; //guards mempool and utxo_manager
+    thread validator;
+    atomic<bool> running;
+    shared_ptr<const vector<Transaction>> top_snapshot; //read and written with atomic_load/atomic_store
+    int snapshot_size;
+    size_t batch_size;
+    chrono::steady_clock::time_point start_time;
+
+    atomic<uint64_t> submitted;
+    atomic<uint64_t> rejected_full;
+    atomic<uint64_t> admitted;
+    atomic<uint64_t> rejected_invalid;
+    atomic<uint64_t> batches;
+    atomic<uint64_t> snapshots;
+    atomic<uint64_t> blocks_mined;
+    atomic<uint64_t> txs_mined;
+
+    //caller holds state_mutex
+    void publish_snapshot()
+    {
+        shared_ptr<const vector<Transaction>> snap = make_shared<const vector<Transaction>>(mempool.get_top_transactions(snapshot_size));
+        atomic_store(&top_snapshot, snap);
+        snapshots++;
+    }
+
+    //drains up to batch_size transactions into the mempool, returns how many were taken
+    size_t validate_batch()
+    {
+        vector<Transaction> batch;
+        Transaction tx;
+        while(batch.size() < batch_size && queue.try_pop(tx))
+            batch.push_back(move(tx));
+        if(batch.empty())
+            return 0;
+
+        lock_guard<mutex> lock(state_mutex);
+        for(auto& t : batch)
+        {
+            auto result = mempool.add_transaction(move(t), utxo_manager);
+            if(result.first)
+                admitted++;
+            else
+                rejected_invalid++;
+        }
+        batches++;
+        publish_snapshot();
+        return batch.size();
+    }
+
+    void validator_loop()
+    {
+        int idle = 0;
+        while(true)
+        {
+            if(validate_batch() > 0)
+            {
+                idle = 0;
+                continue;
+            }
+            if(!running.load(memory_order_acquire))
+            {
+                //producers are done, drain whatever is left and quit
+                while(validate_batch() > 0);
+                return;
+            }
+            if(++idle < 64)
+                this_thread::yield();
+            else
+                this_thread::sleep_for(chrono::microseconds(100));
+        }
+    }
+
+public:
+    TxPipeline(Mempool& mempool, UTXOManager& utxo_manager, size_t queue_capacity = 1024, int snapshot_size = 4, size_t batch_size = 64)
+        : mempool(mempool), utxo_manager(utxo_manager), queue(queue_capacity)
+    {
+        running = false;
+        this->snapshot_size = snapshot_size;
+        this->batch_size = batch_size;
+        submitted = rejected_full = admitted = rejected_invalid = 0;
+        batches = snapshots = blocks_mined = txs_mined = 0;
+        start_time = chrono::steady_clock::now();
+        lock_guard<mutex> lock(state_mutex);
+        publish_snapshot();
+    }
+
+    ~TxPipeline()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        if(running)
+            return;
+        start_time = chrono::steady_clock::now();
+        running = true;
+        validator = thread(&TxPipeline::validator_loop, this);
+    }
+
+    //stops the validator after draining the queue
+    void stop()
+    {
+        running = false;
+        if(validator.joinable())
+            validator.join();
+    }
+
+    //non-blocking submit, false means the queue is full and the caller should back off
+    bool submit(Transaction tx)
+    {
+        if(!queue.try_push(move(tx)))
+        {
+            rejected_full++;
+            return false;
+        }
+        submitted++;
+        return true;
+    }
+
+    //blocking submit with backoff, gives up after timeout
+    bool submit_wait(Transaction tx, chrono::milliseconds timeout = chrono::milliseconds(1000))
+    {
+        auto deadline = chrono::steady_clock::now() + timeout;
+        int spins = 0;
+        while(!queue.try_push(move(tx)))
+        {
+            if(chrono::steady_clock::now() >= deadline)
+            {
+                rejected_full++;
+                return false;
+            }
+            if(++spins < 64)
+                this_thread::yield();
+            else
+                this_thread::sleep_for(chrono::microseconds(50));
+        }
+        submitted++;
+        return true;
+    }
+
+    //latest top-fee set, never blocks on the validator
+    shared_ptr<const vector<Transaction>> snapshot_top() const
+    {
+        return atomic_load(&top_snapshot);
+    }
+
+    //mines under the state lock; producers keep queueing meanwhile
+    Block mine(const string& miner_address, int block_height, double block_reward, int num_txs = 4)
+    {
+        lock_guard<mutex> lock(state_mutex);
+        Block block = mine_block(miner_address, mempool, utxo_manager, block_height, block_reward, num_txs);
+        if(block.block_height != -1)
+        {
+            blocks_mined++;
+            txs_mined += block.transactions.size();
+        }
+        publish_snapshot();
+        return block;
+    }
+
+    PipelineStats stats() const
+    {
+        PipelineStats s;
+        s.submitted = submitted;
+        s.rejected_full = rejected_full;
+        s.admitted = admitted;
+        s.rejected_invalid = rejected_invalid;
+        s.batches = batches;
+        s.snapshots = snapshots;
+        s.blocks_mined = blocks_mined;
+        s.txs_mined = txs_mined;
+        s.elapsed_seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+        double secs = max(s.elapsed_seconds, 1e-9);
+        s.ingest_rate = s.submitted / secs;
+        s.validate_rate = (s.admitted + s.rejected_invalid) / secs;
+        s.mine_rate = s.txs_mined / secs;
+        return s;
+    }
+
+    void display_stats() const
+    {
+        PipelineStats s = stats();
+        cout << "\n--- Pipeline Stats ---" << endl;
+        cout << left << setw(12) << "Stage" << setw(12) << "Count" << setw(12) << "Rejected" << setw(12) << "Tx/s" << endl;
+        cout << left << setw(12) << "ingest" << setw(12) << s.submitted << setw(12) << s.rejected_full << setw(12) << fixed << setprecision(1) << s.ingest_rate << endl;
+        cout << left << setw(12) << "validate" << setw(12) << s.admitted << setw(12) << s.rejected_invalid << setw(12) << fixed << setprecision(1) << s.validate_rate << endl;
+        cout << left << setw(12) << "mine" << setw(12) << s.txs_mined << setw(12) << 0 << setw(12) << fixed << setprecision(1) << s.mine_rate << endl;
+    }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef POLICIES_H
+#define POLICIES_H
+
+#include<bits/stdc++.h>
+#include"transaction.h"
+using namespace std;
+
+//compile-time policies for BasicMempool and BasicSimulator; every hook is a static inline
+//function, so each instantiation gets its own specialized hot path with no runtime dispatch
+
+//fee policies: charge() is what the wallet pays on a payment of amount, minimum() what
+//the mempool demands of a transaction (the fee itself is always inputs minus outputs)
+struct PercentageFee //default: pay rate * amount, the mempool accepts any fee
+{
+    static constexpr bool has_minimum = false;
+    static double charge(double amount, double rate) { return amount * rate; }
+    static double minimum(const Transaction&, double) { return 0; }
+};
+
+struct FlatFee //every transaction pays and must pay rate BTC
+{
+    static constexpr bool has_minimum = true;
+    static double charge(double, double rate) { return rate; }
+    static double minimum(const Transaction&, double rate) { return rate; }
+};
+
+//selection policies: before(a, b) is true if a is mined first
+struct SelectByFee //default: highest absolute fee first
+{
+    static bool before(const Transaction& a, const Transaction& b) { return a.fee > b.fee; }
+};
+
+struct SelectByFeeRate //highest fee per byte first
+{
+    static bool before(const Transaction& a, const Transaction& b) { return fee_rate(a) > fee_rate(b); }
+};
+
+//halving policies: halves(blocks_mined, k) is true if the reward halves after that block
+struct HalveEveryK //default: every k blocks, k given at run time
+{
+    static bool halves(int blocks_mined, int k) { return blocks_mined % k == 0; }
+};
+
+template<int Interval>
+struct HalveEvery //fixed interval, e.g. HalveEvery<210000> as in Bitcoin
+{
+    static_assert(Interval > 0, "halving interval must be positive");
+    static constexpr bool halves(int blocks_mined, int) { return blocks_mined % Interval == 0; }
+};
+
+struct NeverHalve
+{
+    static constexpr bool halves(int, int) { return false; }
+};
+
+#endif
@@ -0,0 +1,379 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include<bits/stdc++.h>
+#include<charconv>
+#include"block.h"
+#include"json.h"
+using namespace std;
+
+//how a view is written: the boxes and tables the menu shows, or one JSON object per line
+//with the same fields the RPC methods return, for scripts
+enum RenderFormat
+{
+    RENDER_TEXT,
+    RENDER_JSON
+};
+
+//which blocks or UTXOs a view covers. Heights are inclusive. offset and limit page
+//through whatever is left after the height range and the owner filter
+struct ViewRange
+{
+    int from_height = 1;
+    int to_height = INT_MAX;
+    string owner; //UTXO views only, empty for every owner
+    size_t offset = 0;
+    size_t limit = SIZE_MAX;
+};
+
+struct ViewPage
+{
+    size_t shown = 0;
+    bool more = false; //records past the limit are still left
+};
+
+//calls visit on each block of chain with a height in the range, skipping the first
+//range.offset of them and stopping after range.limit; the chain is ordered by height
+template<typename Visit>
+ViewPage visit_blocks(const vector<Block>& chain, const ViewRange& range, Visit visit)
+{
+    ViewPage page;
+    auto it = lower_bound(chain.begin(), chain.end(), range.from_height,
+                          [](const Block& b, int height) { return b.block_height < height; });
+    it += min<size_t>(range.offset, chain.end() - it);
+    for(; it != chain.end() && it->block_height <= range.to_height; ++it)
+    {
+        if(page.shown == range.limit)
+        {
+            page.more = true;
+            break;
+        }
+        visit(*it);
+        page.shown++;
+    }
+    return page;
+}
+
+//calls visit on each UTXO of range.owner (every owner if empty) in the set's own order,
+//skipping the first range.offset matches and stopping after range.limit
+template<typename UTXOSet, typename Visit>
+ViewPage visit_utxos(const UTXOSet& utxos, const ViewRange& range, Visit visit)
+{
+    ViewPage page;
+    size_t skipped = 0;
+    for(const auto& u : utxos.utxo_set)
+    {
+        const UTXO& utxo = u.second;
+        if(!range.owner.empty() && utxo.owner != range.owner)
+            continue;
+        if(skipped < range.offset)
+        {
+            skipped++;
+            continue;
+        }
+        if(page.shown == range.limit)
+        {
+            page.more = true;
+            break;
+        }
+        visit(utxo);
+        page.shown++;
+    }
+    return page;
+}
+
+//renders blocks and UTXOs into one buffer that is reused from record to record and view
+//to view, and hands it to the stream only in large writes (no per-row endl or setw)
+class ViewRenderer
+{
+    string buffer;
+    string scratch; //the lines of the block being boxed
+    vector<size_t> line_ends;
+    size_t flush_at;
+    char number[352]; //room for any double in fixed notation
+
+    string_view format_int(long long v)
+    {
+        return string_view(number, to_chars(number, number + sizeof(number), v).ptr - number);
+    }
+
+    //same digits as fixed << setprecision(decimals)
+    string_view format_fixed(double v, int decimals)
+    {
+        auto res = to_chars(number, number + sizeof(number), v, chars_format::fixed, decimals);
+        return string_view(number, res.ec == errc() ? res.ptr - number : 0);
+    }
+
+    //left aligned in width columns, like left << setw(width)
+    void put_padded(string_view s, size_t width)
+    {
+        buffer += s;
+        if(s.size() < width)
+            buffer.append(width - s.size(), ' ');
+    }
+
+    void end_line()
+    {
+        line_ends.push_back(scratch.size());
+    }
+
+    void key(const char* name, bool first = false)
+    {
+        if(!first)
+            buffer += ',';
+        buffer += '"';
+        buffer += name;
+        buffer += "\":";
+    }
+
+    void maybe_flush(ostream& out)
+    {
+        if(buffer.size() >= flush_at)
+            flush(out);
+    }
+
+public:
+    size_t writes = 0; //stream writes made so far
+
+    ViewRenderer(size_t flush_at = 1 << 16) : flush_at(flush_at)
+    {
+        buffer.reserve(flush_at + 4096);
+    }
+
+    void flush(ostream& out)
+    {
+        if(buffer.empty())
+            return;
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        buffer.clear();
+        writes++;
+    }
+
+    //the same box Block::display() prints; returns its width
+    size_t block_text(const Block& block)
+    {
+        scratch.clear();
+        line_ends.clear();
+        scratch += "Block #";
+        scratch += format_int(block.block_height);
+        scratch += " | Miner: ";
+        scratch += block.miner;
+        end_line();
+        scratch += "Time: ";
+        if(block.timestamp.empty() && block.time)
+        {
+            time_t t = (time_t)block.time;
+            string_view text = ctime(&t);
+            if(!text.empty() && text.back() == '\n')
+                text.remove_suffix(1);
+            scratch += text;
+        }
+        else
+            scratch += block.timestamp;
+        end_line();
+        scratch += "Reward: ";
+        scratch += format_fixed(block.block_reward, 3);
+        scratch += " | Fees: ";
+        scratch += format_fixed(block.total_fees, 3);
+        scratch += " BTC";
+        end_line();
+        scratch += "TXs: ";
+        scratch += format_int(block.num_transactions());
+        if(block.pruned)
+            scratch += " (pruned)";
+        end_line();
+        if(block.has_merkle_root())
+        {
+            scratch += "Merkle root: " + crypto::to_hex(block.merkle_root.data(), 8) + "...";
+            end_line();
+        }
+        if(block.has_utxo_hash())
+        {
+            scratch += "UTXO hash: " + crypto::to_hex(block.utxo_hash.data(), 8) + "...";
+            end_line();
+        }
+        for(const auto& tx : block.transactions)
+        {
+            scratch += "  +-- ";
+            scratch.append(tx.tx_id, 0, 8);
+            scratch += "... [";
+            scratch += format_int(tx.inputs.size());
+            scratch += "->";
+            scratch += format_int(tx.outputs.size());
+            scratch += "] Fee: ";
+            scratch += format_fixed(tx.fee, 3);
+            end_line();
+        }
+
+        size_t max_len = 0;
+        for(size_t i = 0, start = 0; i < line_ends.size(); start = line_ends[i++])
+            max_len = max(max_len, line_ends[i] - start);
+        buffer += "\n+";
+        buffer.append(max_len + 2, '-');
+        buffer += "+\n";
+        for(size_t i = 0, start = 0; i < line_ends.size(); start = line_ends[i++])
+        {
+            buffer += "| ";
+            buffer.append(scratch, start, line_ends[i] - start);
+            buffer.append(max_len - (line_ends[i] - start), ' ');
+            buffer += " |\n";
+        }
+        buffer += '+';
+        buffer.append(max_len + 2, '-');
+        buffer += "+\n";
+        return max_len + 4;
+    }
+
+    //one line with the fields of block_to_json()
+    void block_json(const Block& block)
+    {
+        buffer += '{';
+        key("height", true);
+        Json::dump_number(block.block_height, buffer);
+        key("miner");
+        Json::dump_string(block.miner, buffer);
+        key("time");
+        Json::dump_number(block.time, buffer);
+        key("reward");
+        Json::dump_number(block.block_reward, buffer);
+        key("fees");
+        Json::dump_number(block.total_fees, buffer);
+        key("tx_count");
+        Json::dump_number(block.num_transactions(), buffer);
+        key("pruned");
+        buffer += block.pruned ? "true" : "false";
+        if(block.has_merkle_root())
+        {
+            key("merkle_root");
+            Json::dump_string(crypto::to_hex(block.merkle_root.data(), block.merkle_root.size()), buffer);
+        }
+        if(block.has_utxo_hash())
+        {
+            key("utxo_hash");
+            Json::dump_string(crypto::to_hex(block.utxo_hash.data(), block.utxo_hash.size()), buffer);
+        }
+        if(!block.pruned)
+        {
+            key("transactions");
+            buffer += '[';
+            for(size_t t = 0; t < block.transactions.size(); ++t)
+            {
+                const Transaction& tx = block.transactions[t];
+                buffer += t ? ",{" : "{";
+                key("tx_id", true);
+                Json::dump_string(tx.tx_id, buffer);
+                key("fee");
+                Json::dump_number(tx.fee, buffer);
+                key("inputs");
+                buffer += '[';
+                for(size_t i = 0; i < tx.inputs.size(); ++i)
+                {
+                    buffer += i ? ",{" : "{";
+                    key("prev_tx_id", true);
+                    Json::dump_string(tx.inputs[i].prev_tx_id, buffer);
+                    key("index");
+                    Json::dump_number(tx.inputs[i].index, buffer);
+                    key("owner");
+                    Json::dump_string(tx.inputs[i].owner, buffer);
+                    buffer += '}';
+                }
+                buffer += ']';
+                key("outputs");
+                buffer += '[';
+                for(size_t i = 0; i < tx.outputs.size(); ++i)
+                {
+                    buffer += i ? ",{" : "{";
+                    key("amount", true);
+                    Json::dump_number(tx.outputs[i].amount, buffer);
+                    key("address");
+                    Json::dump_string(tx.outputs[i].address, buffer);
+                    buffer += '}';
+                }
+                buffer += "]}";
+            }
+            buffer += ']';
+        }
+        buffer += "}\n";
+    }
+
+    void utxo_text_header()
+    {
+        buffer += "\n--- Current UTXO Set ---\n";
+        put_padded("TX ID", 20);
+        put_padded("Index", 10);
+        put_padded("Amount", 15);
+        put_padded("Owner", 15);
+        buffer += '\n';
+    }
+
+    //a row of UTXOManager::display()
+    void utxo_text(const UTXO& utxo)
+    {
+        put_padded(utxo.tx_id, 20);
+        put_padded(format_int(utxo.index), 10);
+        put_padded(format_fixed(utxo.amount, 3), 15);
+        put_padded(utxo.owner, 15);
+        buffer += '\n';
+    }
+
+    //one line with the fields of utxo_to_json()
+    void utxo_json(const UTXO& utxo)
+    {
+        buffer += '{';
+        key("tx_id", true);
+        Json::dump_string(utxo.tx_id, buffer);
+        key("index");
+        Json::dump_number(utxo.index, buffer);
+        key("amount");
+        Json::dump_number(utxo.amount, buffer);
+        key("owner");
+        Json::dump_string(utxo.owner, buffer);
+        buffer += "}\n";
+    }
+
+    //the blocks of chain the range selects, with arrows between text boxes as in the menu
+    ViewPage render_blocks(const vector<Block>& chain, const ViewRange& range, RenderFormat format, ostream& out)
+    {
+        size_t prev_width = 0;
+        ViewPage page = visit_blocks(chain, range, [&](const Block& block) {
+            if(format == RENDER_JSON)
+                block_json(block);
+            else
+            {
+                if(prev_width)
+                {
+                    size_t center_pos = prev_width / 2 - 3;
+                    buffer += "\n  ";
+                    buffer.append(center_pos - 1, ' ');
+                    buffer += "|\n  ";
+                    buffer.append(center_pos - 1, ' ');
+                    buffer += "v\n";
+                }
+                prev_width = block_text(block);
+            }
+            maybe_flush(out);
+        });
+        flush(out);
+        return page;
+    }
+
+    //the UTXOs the range selects, under the table header in text format
+    template<typename UTXOSet>
+    ViewPage render_utxos(const UTXOSet& utxos, const ViewRange& range, RenderFormat format, ostream& out)
+    {
+        if(format == RENDER_TEXT)
+            utxo_text_header();
+        ViewPage page = visit_utxos(utxos, range, [&](const UTXO& utxo) {
+            if(format == RENDER_JSON)
+                utxo_json(utxo);
+            else
+                utxo_text(utxo);
+            maybe_flush(out);
+        });
+        flush(out);
+        return page;
+    }
+};
+
+#endif
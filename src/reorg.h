@@ -0,0 +1,84 @@
+#ifndef REORG_H
+#define REORG_H
+
+#include<bits/stdc++.h>
+#include"block.h"
+using namespace std;
+
+//switches the active chain to a competing branch that forks after fork_height
+//only the diverging blocks are disconnected and connected, using the per-block undo data
+//transactions from disconnected blocks that the new branch did not confirm go back to the mempool
+template<typename UTXOSet, typename MempoolType>
+pair<bool, string> reorganize_chain(vector<Block>& chain, vector<BlockUndo>& undo_log, int fork_height, const vector<Block>& branch, UTXOSet& utxo_manager, MempoolType& mempool)
+{
+    int tip = chain.size();
+    if(fork_height < 0 || fork_height > tip)
+        return {false, "Fork height " + to_string(fork_height) + " is outside the chain"};
+    if(undo_log.size() != chain.size())
+        return {false, "Undo data missing for the active chain"};
+    for(int i = fork_height; i < tip; ++i)
+    {
+        if(chain[i].pruned)
+            return {false, "Cannot reorganize below pruned block " + to_string(chain[i].block_height)};
+    }
+    if(fork_height + (int)branch.size() <= tip)
+        return {false, "Branch is not longer than the active chain"};
+    for(size_t i = 0; i < branch.size(); ++i)
+    {
+        if(branch[i].block_height != fork_height + 1 + (int)i)
+            return {false, "Branch heights are not contiguous from the fork point"};
+    }
+
+    //disconnect the old tip back to the fork point
+    vector<Block> old_blocks(chain.begin() + fork_height, chain.end());
+    for(int i = tip - 1; i >= fork_height; --i)
+        disconnect_block(undo_log[i], utxo_manager);
+    chain.resize(fork_height);
+    undo_log.resize(fork_height);
+
+    for(const auto& block : branch)
+    {
+        BlockUndo undo;
+        auto result = connect_block(block, utxo_manager, undo, mempool.verifier);
+        if(!result.first)
+        {
+            //put the old branch back
+            for(int i = (int)undo_log.size() - 1; i >= fork_height; --i)
+                disconnect_block(undo_log[i], utxo_manager);
+            chain.resize(fork_height);
+            undo_log.resize(fork_height);
+            for(const auto& old : old_blocks)
+            {
+                BlockUndo old_undo;
+                connect_block(old, utxo_manager, old_undo);
+                chain.push_back(old);
+                undo_log.push_back(old_undo);
+            }
+            return {false, "Reorg aborted: " + result.second};
+        }
+        chain.push_back(block);
+        undo_log.push_back(undo);
+    }
+
+    //drop mempool entries the new branch conflicts with, then re-admit the orphaned transactions
+    mempool.remove_invalid(utxo_manager);
+    set<string> confirmed;
+    for(const auto& block : branch)
+        for(const auto& tx : block.transactions)
+            confirmed.insert(tx.tx_id);
+    int readmitted = 0;
+    for(const auto& block : old_blocks)
+    {
+        for(const auto& tx : block.transactions)
+        {
+            if(confirmed.count(tx.tx_id))
+                continue;
+            if(mempool.add_transaction(tx, utxo_manager).first)
+                readmitted++;
+        }
+    }
+
+    return {true, "Reorganized at height " + to_string(fork_height) + ": disconnected " + to_string(old_blocks.size()) + ", connected " + to_string(branch.size()) + ", re-admitted " + to_string(readmitted) + " transactions"};
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef RICH_LIST_H
+#define RICH_LIST_H
+
+#include<bits/stdc++.h>
+#include<ext/pb_ds/assoc_container.hpp>
+#include<ext/pb_ds/tree_policy.hpp>
+using namespace std;
+
+//per-owner balances and total supply, kept in step with the UTXO set one credit/debit at
+//a time. Owners are also ranked in an order-statistics tree (largest balance first, ties
+//by name), so top-K is O(K + log n) and rank, balance and supply lookups are O(log n) or
+//better, instead of a scan over every UTXO
+class RichList
+{
+    struct Holder
+    {
+        long double balance = 0;
+        size_t utxos = 0;
+    };
+
+    typedef pair<long double, string> Key;
+
+    struct RichestFirst
+    {
+        bool operator()(const Key& a, const Key& b) const
+        {
+            if(a.first != b.first)
+                return a.first > b.first;
+            return a.second < b.second;
+        }
+    };
+
+    typedef __gnu_pbds::tree<Key, __gnu_pbds::null_type, RichestFirst, __gnu_pbds::rb_tree_tag,
+                             __gnu_pbds::tree_order_statistics_node_update> Ranking;
+
+    unordered_map<string, Holder> holders;
+    Ranking ranking;
+    long double supply = 0; //long double so long add/remove runs do not drift
+    size_t utxo_count = 0;
+
+public:
+    void credit(const string& owner, double amount)
+    {
+        auto ins = holders.try_emplace(owner);
+        Holder& h = ins.first->second;
+        if(!ins.second)
+            ranking.erase({h.balance, owner});
+        h.balance += amount;
+        h.utxos++;
+        ranking.insert({h.balance, owner});
+        supply += amount;
+        utxo_count++;
+    }
+
+    //owners whose last UTXO goes are dropped, so rounding never leaves dust balances behind
+    void debit(const string& owner, double amount)
+    {
+        auto it = holders.find(owner);
+        if(it == holders.end())
+            return;
+        Holder& h = it->second;
+        ranking.erase({h.balance, owner});
+        if(--h.utxos == 0)
+            holders.erase(it);
+        else
+        {
+            h.balance -= amount;
+            ranking.insert({h.balance, owner});
+        }
+        supply -= amount;
+        if(--utxo_count == 0)
+            supply = 0;
+    }
+
+    //the k largest holders, richest first
+    vector<pair<string, double>> top(size_t k) const
+    {
+        vector<pair<string, double>> result;
+        result.reserve(min(k, ranking.size()));
+        for(auto it = ranking.begin(); it != ranking.end() && result.size() < k; ++it)
+            result.push_back({it->second, (double)it->first});
+        return result;
+    }
+
+    //1 for the richest owner, 0 if owner holds nothing
+    size_t rank(const string& owner) const
+    {
+        auto it = holders.find(owner);
+        if(it == holders.end())
+            return 0;
+        return ranking.order_of_key({it->second.balance, owner}) + 1;
+    }
+
+    double balance(const string& owner) const
+    {
+        auto it = holders.find(owner);
+        return it == holders.end() ? 0 : (double)it->second.balance;
+    }
+
+    double total_supply() const
+    {
+        return (double)supply;
+    }
+
+    size_t num_holders() const
+    {
+        return holders.size();
+    }
+
+    void display(size_t k) const
+    {
+        cout << "\n--- Top " << k << " Holders (" << num_holders() << " owners, supply " << fixed << setprecision(3) << total_supply() << " BTC) ---" << endl;
+        cout << left << setw(8) << "Rank" << setw(15) << "Owner" << setw(15) << "Balance" << "Share" << endl;
+        size_t rank = 1;
+        for(const auto& h : top(k))
+        {
+            double share = supply > 0 ? 100.0 * h.second / total_supply() : 0;
+            cout << left << setw(8) << rank++ << setw(15) << h.first << setw(15) << fixed << setprecision(3) << h.second << setprecision(2) << share << "%" << endl;
+        }
+    }
+};
+
+#endif
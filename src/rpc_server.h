@@ -0,0 +1,486 @@
+#ifndef RPC_SERVER_H
+#define RPC_SERVER_H
+
+#include<bits/stdc++.h>
+#include<sys/epoll.h>
+#include<sys/eventfd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<netinet/in.h>
+#include<arpa/inet.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include"json.h"
+#include"block.h"
+using namespace std;
+
+Json utxo_to_json(const UTXO& utxo)
+{
+    Json j = Json::object();
+    j.set("tx_id", utxo.tx_id).set("index", utxo.index).set("amount", utxo.amount).set("owner", utxo.owner);
+    return j;
+}
+
+Json transaction_to_json(const Transaction& tx)
+{
+    Json inputs = Json::array();
+    for(const auto& in : tx.inputs)
+    {
+        Json i = Json::object();
+        i.set("prev_tx_id", in.prev_tx_id).set("index", in.index).set("owner", in.owner);
+        inputs.push(move(i));
+    }
+    Json outputs = Json::array();
+    for(const auto& out : tx.outputs)
+    {
+        Json o = Json::object();
+        o.set("amount", out.amount).set("address", out.address);
+        outputs.push(move(o));
+    }
+    Json j = Json::object();
+    j.set("tx_id", tx.tx_id).set("fee", tx.fee).set("inputs", move(inputs)).set("outputs", move(outputs));
+    return j;
+}
+
+//pruned blocks carry only their summary fields
+Json block_to_json(const Block& block)
+{
+    Json j = Json::object();
+    j.set("height", block.block_height).set("miner", block.miner).set("time", block.time);
+    j.set("reward", block.block_reward).set("fees", block.total_fees).set("tx_count", block.num_transactions());
+    j.set("pruned", block.pruned);
+    if(block.has_merkle_root())
+        j.set("merkle_root", crypto::to_hex(block.merkle_root.data(), block.merkle_root.size()));
+    if(block.has_utxo_hash())
+        j.set("utxo_hash", crypto::to_hex(block.utxo_hash.data(), block.utxo_hash.size()));
+    if(!block.pruned)
+    {
+        Json txs = Json::array();
+        for(const auto& tx : block.transactions)
+            txs.push(transaction_to_json(tx));
+        j.set("transactions", move(txs));
+    }
+    return j;
+}
+
+//JSON-RPC 2.0 server on a localhost TCP port and/or a Unix domain socket. One thread runs
+//an epoll loop over non-blocking sockets; requests are newline-delimited JSON documents.
+//Every request runs with state_mutex held, and a batch holds it once for all of its calls,
+//so a batch is applied atomically with respect to other connections and other threads.
+class RpcServer
+{
+public:
+    typedef function<pair<bool, string>(const Json& params, Json& result)> Method;
+
+    static const int PARSE_ERROR = -32700;
+    static const int INVALID_REQUEST = -32600;
+    static const int METHOD_NOT_FOUND = -32601;
+    static const int INVALID_PARAMS = -32602;
+    static const int INTERNAL_ERROR = -32603;
+    static const int METHOD_FAILED = -32000; //a handler returned false
+    static const size_t MAX_LINE = 1 << 20;
+    static const size_t MAX_PENDING_OUTPUT = 4 << 20; //a connection is not read while more is unsent
+
+    //thrown by a method whose params have the wrong type or range, answered with INVALID_PARAMS
+    struct InvalidParams : runtime_error
+    {
+        using runtime_error::runtime_error;
+    };
+
+    mutex state_mutex; //guards whatever the methods touch; take it to share that state
+
+    size_t requests = 0;
+    size_t batches = 0;
+    size_t lock_acquisitions = 0;
+    size_t connections = 0;
+
+private:
+    struct Connection
+    {
+        string in;
+        string out;
+        bool closing = false;
+        bool paused = false; //in may hold complete lines, left until out drains
+    };
+
+    map<string, Method> methods;
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    int tcp_fd = -1;
+    int unix_fd = -1;
+    string unix_path;
+    unordered_map<int, Connection> clients;
+    atomic<bool> stopping{false};
+
+    static bool set_nonblocking(int fd)
+    {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    bool watch(int fd, uint32_t events, int op = EPOLL_CTL_ADD)
+    {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+        return epoll_ctl(epoll_fd, op, fd, &ev) == 0;
+    }
+
+    pair<bool, string> add_listener(int fd)
+    {
+        if(listen(fd, 64) != 0 || !set_nonblocking(fd) || !watch(fd, EPOLLIN))
+        {
+            string err = strerror(errno);
+            close(fd);
+            return {false, "Error: listen failed: " + err};
+        }
+        return {true, ""};
+    }
+
+    static Json error_response(const Json& id, int code, const string& message)
+    {
+        Json err = Json::object();
+        err.set("code", code).set("message", message);
+        Json j = Json::object();
+        j.set("jsonrpc", "2.0").set("error", move(err)).set("id", id);
+        return j;
+    }
+
+    //runs one call with the lock already held; a Null result means no response (notification)
+    Json process(const Json& req)
+    {
+        requests++;
+        const Json* id = req.is_object() ? req.get("id") : nullptr;
+        Json response_id = id ? *id : Json();
+        const Json* method = req.is_object() ? req.get("method") : nullptr;
+        if(!method || !method->is_string())
+            return error_response(response_id, INVALID_REQUEST, "Invalid Request");
+        const Json* params = req.get("params");
+        Json no_params = Json::object();
+        if(params && !params->is_object() && !params->is_array())
+            return error_response(response_id, INVALID_REQUEST, "params must be an object or array");
+
+        auto it = methods.find(method->text);
+        Json response;
+        if(it == methods.end())
+            response = error_response(response_id, METHOD_NOT_FOUND, "Method not found: " + method->text);
+        else
+        {
+            Json result;
+            try
+            {
+                auto status = it->second(params ? *params : no_params, result);
+                if(status.first)
+                {
+                    response = Json::object();
+                    response.set("jsonrpc", "2.0").set("result", move(result)).set("id", response_id);
+                }
+                else
+                    response = error_response(response_id, METHOD_FAILED, status.second);
+            }
+            catch(const InvalidParams& e)
+            {
+                response = error_response(response_id, INVALID_PARAMS, e.what());
+            }
+            catch(const exception& e)
+            {
+                response = error_response(response_id, INTERNAL_ERROR, e.what());
+            }
+        }
+        return id ? response : Json();
+    }
+
+    void flush(int fd, Connection& c)
+    {
+        while(!c.out.empty())
+        {
+            ssize_t n = send(fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+            if(n > 0)
+            {
+                c.out.erase(0, n);
+                continue;
+            }
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                //a paused connection is only watched for room to write
+                watch(fd, c.paused ? EPOLLOUT : EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+                return;
+            }
+            c.closing = true; //peer is gone
+            c.out.clear();
+            return;
+        }
+        watch(fd, EPOLLIN, EPOLL_CTL_MOD);
+    }
+
+    void drop(int fd)
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        clients.erase(fd);
+    }
+
+    void accept_all(int listen_fd)
+    {
+        while(true)
+        {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0)
+                return;
+            if(!watch(fd, EPOLLIN))
+            {
+                close(fd);
+                continue;
+            }
+            clients[fd];
+            connections++;
+        }
+    }
+
+    //answers the complete lines in c.in and keeps the unfinished rest; a line, finished or
+    //not, longer than MAX_LINE is rejected and the connection closed. Bytes before fresh
+    //hold no newline. Once c.out holds more than MAX_PENDING_OUTPUT the connection is
+    //paused with the remaining lines kept in c.in
+    void process_lines(Connection& c, size_t fresh)
+    {
+        size_t start = 0;
+        bool too_long = false;
+        c.paused = false;
+        for(size_t nl = c.in.find('\n', fresh); nl != string::npos; nl = c.in.find('\n', start))
+        {
+            if((too_long = nl - start > MAX_LINE))
+                break;
+            if((c.paused = c.out.size() > MAX_PENDING_OUTPUT))
+                break;
+            string reply = handle_line(string_view(c.in).substr(start, nl - start));
+            if(!reply.empty())
+            {
+                c.out += reply;
+                c.out += '\n';
+            }
+            start = nl + 1;
+        }
+        c.in.erase(0, start);
+        if(too_long || (!c.paused && c.in.size() > MAX_LINE))
+        {
+            c.out += error_response(Json(), INVALID_REQUEST, "Request too large").dump() + "\n";
+            string().swap(c.in);
+            c.closing = true;
+        }
+    }
+
+    //lines are answered as they arrive, so the buffer never holds more than MAX_LINE plus
+    //one read; once a request is rejected nothing more is read from the connection. While
+    //the peer leaves more than MAX_PENDING_OUTPUT unread, nothing is read either: the
+    //buffered lines are answered once flush() drains the output
+    void on_readable(int fd)
+    {
+        Connection& c = clients[fd];
+        char buf[16384];
+        do
+        {
+            if(c.paused)
+                process_lines(c, 0);
+            while(!c.closing && !c.paused)
+            {
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                if(n > 0)
+                {
+                    size_t fresh = c.in.size();
+                    c.in.append(buf, n);
+                    process_lines(c, fresh);
+                    continue;
+                }
+                if(n < 0 && errno == EINTR)
+                    continue;
+                if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                    c.closing = true;
+                break;
+            }
+            flush(fd, c);
+        } while(c.paused && c.out.empty() && !c.closing);
+        if(c.closing && c.out.empty())
+            drop(fd);
+    }
+
+public:
+    RpcServer()
+    {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        watch(wake_fd, EPOLLIN);
+    }
+
+    ~RpcServer()
+    {
+        for(auto& c : clients)
+            close(c.first);
+        if(tcp_fd >= 0)
+            close(tcp_fd);
+        if(unix_fd >= 0)
+        {
+            close(unix_fd);
+            unlink(unix_path.c_str());
+        }
+        close(wake_fd);
+        close(epoll_fd);
+    }
+
+    RpcServer(const RpcServer&) = delete;
+    RpcServer& operator=(const RpcServer&) = delete;
+
+    void register_method(const string& name, Method method)
+    {
+        methods[name] = move(method);
+    }
+
+    //binds 127.0.0.1:port, port 0 picks a free one (see port())
+    pair<bool, string> listen_tcp(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0)
+            return {false, string("Error: socket failed: ") + strerror(errno)};
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            string err = strerror(errno);
+            close(fd);
+            return {false, "Error: cannot bind 127.0.0.1:" + to_string(port) + ": " + err};
+        }
+        auto result = add_listener(fd);
+        if(!result.first)
+            return result;
+        tcp_fd = fd;
+        return {true, "Listening on 127.0.0.1:" + to_string(this->port())};
+    }
+
+    //binds a Unix domain socket at path, replacing a stale socket file
+    pair<bool, string> listen_unix(const string& path)
+    {
+        sockaddr_un addr = {};
+        if(path.size() >= sizeof(addr.sun_path))
+            return {false, "Error: socket path too long"};
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0)
+            return {false, string("Error: socket failed: ") + strerror(errno)};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        unlink(path.c_str());
+        if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            string err = strerror(errno);
+            close(fd);
+            return {false, "Error: cannot bind " + path + ": " + err};
+        }
+        auto result = add_listener(fd);
+        if(!result.first)
+            return result;
+        unix_fd = fd;
+        unix_path = path;
+        return {true, "Listening on " + path};
+    }
+
+    uint16_t port() const
+    {
+        sockaddr_in addr = {};
+        socklen_t len = sizeof(addr);
+        if(tcp_fd < 0 || getsockname(tcp_fd, (sockaddr*)&addr, &len) != 0)
+            return 0;
+        return ntohs(addr.sin_port);
+    }
+
+    //answers one request line (a single call or a batch); empty when nothing is owed back
+    string handle_line(string_view line)
+    {
+        Json req;
+        string error;
+        if(!Json::parse(line, req, error))
+            return error_response(Json(), PARSE_ERROR, "Parse error: " + error).dump();
+
+        if(!req.is_array())
+        {
+            lock_guard<mutex> guard(state_mutex);
+            lock_acquisitions++;
+            Json response = process(req);
+            return response.is_null() ? "" : response.dump();
+        }
+
+        if(req.items.empty())
+            return error_response(Json(), INVALID_REQUEST, "Empty batch").dump();
+        Json responses = Json::array();
+        {
+            lock_guard<mutex> guard(state_mutex);
+            lock_acquisitions++;
+            batches++;
+            for(const auto& call : req.items)
+            {
+                Json response = process(call);
+                if(!response.is_null())
+                    responses.push(move(response));
+            }
+        }
+        return responses.items.empty() ? "" : responses.dump();
+    }
+
+    //serves connections until stop() is called
+    void run()
+    {
+        stopping = false;
+        epoll_event events[64];
+        while(!stopping)
+        {
+            int n = epoll_wait(epoll_fd, events, 64, -1);
+            if(n < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                break;
+            }
+            for(int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if(fd == wake_fd)
+                {
+                    uint64_t v;
+                    while(read(wake_fd, &v, sizeof(v)) > 0) {}
+                }
+                else if(fd == tcp_fd || fd == unix_fd)
+                    accept_all(fd);
+                else if(clients.count(fd))
+                {
+                    if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                        on_readable(fd);
+                    else if(events[i].events & EPOLLOUT)
+                    {
+                        Connection& c = clients[fd];
+                        flush(fd, c);
+                        if(c.paused && c.out.empty())
+                            on_readable(fd); //answers the lines held back, then reads again
+                        else if(c.closing && c.out.empty())
+                            drop(fd);
+                    }
+                }
+            }
+        }
+        while(!clients.empty())
+            drop(clients.begin()->first);
+    }
+
+    //safe to call from any thread or a signal handler
+    void stop()
+    {
+        stopping = true;
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef SIGNATURES_H
+#define SIGNATURES_H
+
+#include<bits/stdc++.h>
+#include"crypto.h"
+#include"transaction.h"
+using namespace std;
+
+//digest every input owner signs: tx id, spent outpoints and outputs
+//signatures and the fee (computed by the mempool) are not covered
+crypto::Digest transaction_digest(const Transaction& tx)
+{
+    crypto::Sha512 h;
+    auto put_u64 = [&](uint64_t v) {
+        uint8_t b[8];
+        for(int i = 0; i < 8; ++i)
+            b[i] = (uint8_t)(v >> (8 * i));
+        h.update(b, 8);
+    };
+    auto put_string = [&](const string& s) {
+        put_u64(s.size());
+        h.update(s);
+    };
+    put_string(tx.tx_id);
+    put_u64(tx.inputs.size());
+    for(const auto& input : tx.inputs)
+    {
+        put_string(input.prev_tx_id);
+        put_u64((uint64_t)(int64_t)input.index);
+    }
+    put_u64(tx.outputs.size());
+    for(const auto& output : tx.outputs)
+    {
+        uint64_t bits;
+        memcpy(&bits, &output.amount, sizeof(bits));
+        put_u64(bits);
+        put_string(output.address);
+    }
+    return h.final();
+}
+
+//one Ed25519 keypair per owner, the private half never leaves this class
+class KeyStore
+{
+    map<string, pair<crypto::PublicKey, crypto::SecretKey>> keys;
+    random_device rd;
+
+public:
+    //returns the owner's public key, generating a keypair on first use
+    const crypto::PublicKey& ensure(const string& owner)
+    {
+        auto it = keys.find(owner);
+        if(it != keys.end())
+            return it->second.first;
+        uint8_t seed[32];
+        for(int i = 0; i < 32; i += 4)
+        {
+            uint32_t r = rd();
+            memcpy(seed + i, &r, 4);
+        }
+        auto& kp = keys[owner];
+        crypto::keypair_from_seed(seed, kp.first, kp.second);
+        return kp.first;
+    }
+
+    bool has(const string& owner) const
+    {
+        return keys.count(owner) > 0;
+    }
+
+    //signs every input with its owner's key, false if an owner has no key here
+    bool sign_transaction(Transaction& tx) const
+    {
+        crypto::Digest digest = transaction_digest(tx);
+        for(auto& input : tx.inputs)
+        {
+            auto it = keys.find(input.owner);
+            if(it == keys.end())
+                return false;
+            crypto::Signature sig = crypto::sign(digest.data(), digest.size(), it->second.second);
+            input.signature.assign((const char*)sig.data(), sig.size());
+        }
+        return true;
+    }
+};
+
+struct SigCacheStats
+{
+    uint64_t hits; //signatures accepted from the cache
+    uint64_t verified; //full Ed25519 verifications that passed
+    uint64_t failures;
+};
+
+//checks that each input is signed by the owner of the UTXO it spends
+//verified (digest, key, signature) triples are cached so connecting a block
+//does not redo the work done at mempool admission
+class SignatureVerifier
+{
+    map<string, crypto::PublicKey> registry; //owner -> public key
+    unordered_set<string> cache;
+    deque<string> cache_order; //FIFO eviction
+    size_t cache_capacity;
+    mutable mutex cache_mutex;
+    atomic<uint64_t> hits;
+    atomic<uint64_t> verified;
+    atomic<uint64_t> failures;
+
+    static string cache_key(const crypto::Digest& digest, const crypto::PublicKey& pk, const string& sig)
+    {
+        crypto::Sha512 h;
+        h.update(digest.data(), digest.size()).update(pk.data(), pk.size()).update(sig);
+        crypto::Digest d = h.final();
+        return string((const char*)d.data(), 32);
+    }
+
+    bool in_cache(const string& key) const
+    {
+        lock_guard<mutex> lock(cache_mutex);
+        return cache.count(key) > 0;
+    }
+
+    void remember(const string& key)
+    {
+        lock_guard<mutex> lock(cache_mutex);
+        if(!cache.insert(key).second)
+            return;
+        cache_order.push_back(key);
+        if(cache_order.size() > cache_capacity)
+        {
+            cache.erase(cache_order.front());
+            cache_order.pop_front();
+        }
+    }
+
+public:
+    SignatureVerifier(size_t cache_capacity = 100000)
+    {
+        this->cache_capacity = cache_capacity;
+        hits = verified = failures = 0;
+    }
+
+    void register_key(const string& owner, const crypto::PublicKey& pk)
+    {
+        registry[owner] = pk;
+    }
+
+    //ownership and signature check for every input, reads the UTXO set only
+    template<typename UTXOSet>
+    pair<bool, string> check_transaction(const Transaction& tx, const UTXOSet& utxo_manager)
+    {
+        crypto::Digest digest = transaction_digest(tx);
+        for(const auto& input : tx.inputs)
+        {
+            string outpoint = input.prev_tx_id + ":" + to_string(input.index);
+            const UTXO* u = utxo_manager.find_utxo(input.prev_tx_id, input.index);
+            if(!u)
+                return {false, "Input UTXO does not exist: " + outpoint};
+            const string& owner = u->owner;
+            if(input.owner != owner)
+                return {false, "Input owner " + input.owner + " does not own " + outpoint};
+            auto key = registry.find(owner);
+            if(key == registry.end())
+                return {false, "No public key registered for " + owner};
+            if(input.signature.size() != 64)
+            {
+                failures++;
+                return {false, "Missing signature for " + outpoint};
+            }
+
+            string ck = cache_key(digest, key->second, input.signature);
+            if(in_cache(ck))
+            {
+                hits++;
+                continue;
+            }
+            crypto::Signature sig;
+            memcpy(sig.data(), input.signature.data(), 64);
+            if(!crypto::verify(digest.data(), digest.size(), sig, key->second))
+            {
+                failures++;
+                return {false, "Invalid signature for " + outpoint};
+            }
+            verified++;
+            remember(ck);
+        }
+        return {true, "Signatures valid"};
+    }
+
+    //verifies many transactions across threads, results are in input order
+    template<typename UTXOSet>
+    vector<pair<bool, string>> check_batch(const vector<Transaction>& txs, const UTXOSet& utxo_manager, int num_threads = 0)
+    {
+        vector<pair<bool, string>> results(txs.size());
+        if(txs.empty())
+            return results;
+        if(num_threads <= 0)
+            num_threads = max(1u, thread::hardware_concurrency());
+        num_threads = min<int>(num_threads, txs.size());
+        atomic<size_t> next(0);
+        vector<thread> workers;
+        for(int t = 0; t < num_threads; ++t)
+        {
+            workers.emplace_back([&]() {
+                size_t i;
+                while((i = next++) < txs.size())
+                    results[i] = check_transaction(txs[i], utxo_manager);
+            });
+        }
+        for(auto& w : workers)
+            w.join();
+        return results;
+    }
+
+    SigCacheStats stats() const
+    {
+        SigCacheStats s;
+        s.hits = hits;
+        s.verified = verified;
+        s.failures = failures;
+        return s;
+    }
+
+    size_t cache_size() const
+    {
+        lock_guard<mutex> lock(cache_mutex);
+        return cache.size();
+    }
+};
+
+#endif
@@ -3,26 +3,84 @@
 
 #include<bits/stdc++.h>
 #include"block.h"
+#include"pipeline.h"
+#include"chain_index.h"
+#include"reorg.h"
+#include"compact_block.h"
+#include"utxo_store.h"
+#include"parallel_connect.h"
+#include"rpc_server.h"
+#include"event_log.h"
+#include"render.h"
 #include "../test/tests.h"
+#include "../test/stress_tests.h"
 
 using namespace std;
 
 const double epsilon = 1e-9;
-static int counter = 0;
 
-class Simulator 
+//Fee decides what a payment pays and the mempool requires, Selection which transactions
+//are mined first, Halving when the block reward halves and Storage the in-memory UTXO
+//container; BlockTxs is the number of transactions per mined block. Simulator is the default setup.
+template<typename Fee = PercentageFee, typename Selection = SelectByFee, typename Halving = HalveEveryK,
+         typename Storage = OrderedUTXOMap, int BlockTxs = 4>
+class BasicSimulator 
 {
-    UTXOManager utxo_manager;
-    Mempool mempool;
+    typedef BasicMempool<Selection, Fee> MempoolType;
+
+    BasicUTXOManager<Storage> utxo_manager;
+    MempoolType mempool;
     vector<Block> blockchain;
+    vector<BlockUndo> undo_log; //one entry per block in blockchain
+    KeyStore wallet;
+    SignatureVerifier verifier;
+    ChainIndex chain_index;
+    bool indexing = false;
+    int prune_depth = 0; //0 keeps every block body
+    int last_pruned = 0; //height of the newest pruned block, pruning resumes above it
+    FeeEstimator fee_estimator;
+    string fee_estimates_path; //empty keeps fee estimates in memory only
     double gas_fee;
     double block_reward;
     int k;
+    int counter = 0; //blocks mined, drives the reward halving
+    double genesis_supply = 0;
+    mt19937_64 rng; //transaction id suffixes
+    SimConfig config;
+    int64_t start_time; //steady clock seconds when the run started
+    int64_t replay_time = -1; //while replaying, the recorded time of the current event
+    EventLogWriter recorder;
+    ViewRenderer renderer; //one output buffer for every block and UTXO view
+
+    //the mempool's clock: wall time normally, the recorded event time during a replay
+    int64_t clock_now() const
+    {
+        return replay_time >= 0 ? start_time + replay_time : MempoolType::now_seconds();
+    }
+
+    void record(SimEvent e)
+    {
+        if(!recorder.is_open())
+            return;
+        e.time = clock_now() - start_time;
+        recorder.write(e);
+    }
+
 public:
-    Simulator(double gas_fee = 0.0, double block_reward = 12, int mempool_maxsize = 5, int k = 3) 
+    //seed 0 picks a random seed; the seed in use is written to event logs
+    BasicSimulator(double gas_fee = 0.0, double block_reward = 12, int mempool_maxsize = 5, int k = 3, size_t mempool_max_bytes = 1 << 20, int64_t mempool_expiry = 3600, uint64_t seed = 0) 
     {
+        if(seed == 0)
+            seed = ((uint64_t)random_device()() << 32) | random_device()();
+        config = {gas_fee, block_reward, mempool_maxsize, k, mempool_max_bytes, mempool_expiry, seed};
+        rng.seed(seed);
         this->gas_fee = gas_fee;
-        mempool = Mempool(mempool_maxsize, gas_fee);
+        start_time = MempoolType::now_seconds();
+        mempool = MempoolType(mempool_maxsize, gas_fee, mempool_max_bytes, mempool_expiry);
+        mempool.clock = [this]() { return clock_now(); };
+        mempool.verifier = &verifier;
+        mempool.replace_by_fee = true;
+        mempool.fee_estimator = &fee_estimator;
         this->block_reward = block_reward;
         if(k<=0)
         {
@@ -34,13 +92,93 @@ public:
         utxo_manager.add_utxo("genesis", 2, 20.0, "Charlie");
         utxo_manager.add_utxo("genesis", 3, 10.0, "David");
         utxo_manager.add_utxo("genesis", 4, 5.0, "Eve");
+        for(auto const& u : utxo_manager.utxo_set)
+        {
+            chain_index.add_genesis_output(u.second.tx_id, u.second.index, u.second.amount, u.second.owner);
+            ensure_keys(u.second.owner);
+        }
+        genesis_supply = utxo_manager.rich_list.total_supply();
+    }
+
+    //gives the owner a keypair and registers its public key with the verifier
+    void ensure_keys(const string& owner)
+    {
+        verifier.register_key(owner, wallet.ensure(owner));
+    }
+
+    //loads fee estimator state saved at path, if any, and saves it there on exit
+    //returns false if a file exists there but cannot be used
+    bool use_fee_estimates(const string& path)
+    {
+        fee_estimates_path = path;
+        ifstream exists(path);
+        return !exists || fee_estimator.load(path);
+    }
+
+    //turns the txid/address indexes on, an existing chain is indexed in bulk
+    //refused once blocks have been pruned, their transactions can no longer be indexed
+    pair<bool, string> enable_indexing(int num_threads = 0)
+    {
+        if(indexing)
+            return {true, ""};
+        if(!chain_index.rebuild(blockchain, num_threads))
+            return {false, "Cannot index the chain: pruned blocks no longer have their transactions"};
+        indexing = true;
+        return {true, ""};
+    }
+
+    const ChainIndex* get_chain_index() const
+    {
+        return indexing ? &chain_index : nullptr;
+    }
+
+    //keeps full bodies only for the newest depth blocks, older ones shrink to summaries
+    //reorganizations cannot reach below the pruned part of the chain
+    void enable_pruning(int depth)
+    {
+        SimEvent e;
+        e.type = EVENT_PRUNING;
+        e.depth = depth;
+        record(e);
+        prune_depth = max(depth, 1);
+        prune_chain(blockchain, undo_log, prune_depth, &last_pruned);
+    }
+
+    //mines the next block, applies halving and appends it to the chain
+    Block mine_next_block(const string& miner)
+    {
+        SimEvent e;
+        e.type = EVENT_MINE;
+        e.miner = miner;
+        record(e);
+        mempool.expire();
+        ensure_keys(miner);
+        BlockUndo undo;
+        double supply_before = utxo_manager.rich_list.total_supply();
+        Block new_block = mine_block(miner, mempool, utxo_manager, blockchain.size() + 1, block_reward, BlockTxs, &undo);
+        if (new_block.block_height != -1) {
+            //fees only move coins, so a block may add exactly its reward to the supply
+            double issued = utxo_manager.rich_list.total_supply() - supply_before;
+            if(fabs(issued - new_block.block_reward) > epsilon * max(1.0, supply_before))
+                cout << "Warning: block " << new_block.block_height << " changed the supply by " << issued << " BTC, its reward is " << new_block.block_reward << " BTC" << endl;
+            counter++;
+            if(Halving::halves(counter, k))
+            block_reward/=2;
+            blockchain.push_back(new_block);
+            undo_log.push_back(undo);
+            if(indexing)
+                chain_index.index_block(blockchain.back());
+            if(prune_depth > 0)
+                prune_chain(blockchain, undo_log, prune_depth, &last_pruned);
+        }
+        return new_block;
     }
 
 
         void run_test_scenarios(int k, double gas_fee) {
     cout << "========== Running Test Suite ==========" << endl;
     int passed = 0;
-    const int total = 13;
+    const int total = 37;
     if (test_basic_valid_transaction(gas_fee)) passed++;
     if (test_multiple_inputs(gas_fee)) passed++;
     if (test_double_spend_same_tx()) passed++;
@@ -54,44 +192,60 @@ public:
     if (test_mempool_transaction_limit()) passed++;
     if (test_block_transaction_limit()) passed++;
     if (test_block_reward_halving(k)) passed++;
+    if (test_concurrent_pipeline()) passed++;
+    if (test_chain_index()) passed++;
+    if (test_chain_reorg()) passed++;
+    if (test_signature_validation()) passed++;
+    if (test_fee_estimator()) passed++;
+    if (test_mempool_memory_budget()) passed++;
+    if (test_mempool_expiry()) passed++;
+    if (test_replace_by_fee()) passed++;
+    if (test_compact_block()) passed++;
+    if (test_utxo_disk_cache()) passed++;
+    if (test_utxo_set_hash()) passed++;
+    if (test_parallel_connect()) passed++;
+    if (test_block_pruning()) passed++;
+    if (test_allocation_free_lookups()) passed++;
+    if (test_rpc_server<BasicSimulator>()) passed++;
+    if (test_event_log_replay<BasicSimulator>()) passed++;
+    if (test_stress_suite()) passed++;
+    if (test_policies()) passed++;
+    if (test_rich_list_supply<BasicSimulator>()) passed++;
+    if (test_paginated_views()) passed++;
+    if (test_reorg_halving<BasicSimulator>()) passed++;
+    if (test_crypto_vectors()) passed++;
+    if (test_utxo_cache_interface()) passed++;
+    if (test_replay_eviction<BasicSimulator>()) passed++;
 
     cout << "========================================" << endl;
     cout << "Passed " << passed << " / " << total << " tests." << endl;
 }
     
 
-    void create_transaction_ui() 
+    //builds, signs and submits a payment from the sender's UTXOs that are not already
+    //pending in the mempool; on success tx_id receives the new transaction's id
+    pair<bool, string> create_transaction(const string& sender, const string& recipient, double amount, string* tx_id = nullptr)
     {
-        string sender, recipient;
-        double amount;
-        cout << "Enter sender: ";
-        cin >> sender;
-        
+        SimEvent e;
+        e.type = EVENT_CREATE_TX;
+        e.sender = sender;
+        e.recipient = recipient;
+        e.amount = amount;
+        record(e);
+        mempool.expire();
+
         double balance = utxo_manager.get_balance(sender);
-        cout << "Available balance: " << balance << " BTC" << endl;
-        
         if(balance == 0) //sender is broke
-        {
-            cout << "Error: Sender has no balance." << endl;
-            return;
-        }
-
-        cout << "Enter recipient: ";
-        cin >> recipient;
-        cout << "Enter amount: ";
-        cin >> amount;
-
+            return {false, "Error: Sender has no balance."};
         if(amount > balance) //cant send more than u have
-        {
-            cout << "Error: Insufficient funds." << endl;
-            return;
-        }
+            return {false, "Error: Insufficient funds."};
 
         vector<UTXO> sender_utxos = utxo_manager.get_utxos_for_owner(sender);
         Transaction tx;
-        tx.tx_id = "tx_" + sender + "_" + recipient + "_" + to_string(rand() % 1000);
+        tx.tx_id = "tx_" + sender + "_" + recipient + "_" + to_string(uniform_int_distribution<int>(0, 999)(rng));
         
         double total_input = 0;
+        double required = amount + Fee::charge(amount, gas_fee);
 
 
         for(const auto& utxo : sender_utxos) 
@@ -104,26 +258,19 @@ public:
             total_input += utxo.amount;
             
             //dont have to use all utxos
-            if (total_input >= amount*(1 + gas_fee)) 
+            if (total_input >= required) 
             break; 
         }
         
         //too less funds that are not in mempool
         if(total_input + epsilon < amount) 
-        {
-            cout << "Error: All available UTXOs are already pending in mempool." << endl;
-            return;
-        }
-        else if(total_input + epsilon < amount*(1+gas_fee))
-        {
-            //cant pay fee
-            cout << "Error: Insufficient funds for fee." << endl;
-            return;
-        }
+            return {false, "Error: All available UTXOs are already pending in mempool."};
+        else if(total_input + epsilon < required)
+            return {false, "Error: Insufficient funds for fee."}; //cant pay fee
 
         tx.outputs.push_back({amount, recipient});
 
-        double change = total_input - amount*(1+gas_fee);
+        double change = total_input - required;
         if(abs(change) < epsilon)
             change = 0;
             
@@ -132,38 +279,449 @@ public:
             tx.outputs.push_back({change, sender});
         } 
 
+        ensure_keys(recipient);
+        wallet.sign_transaction(tx);
+
+        double suggested = fee_estimator.estimate_fee(tx, 1);
+        if(suggested >= 0)
+            cout << "Suggested fee for next block: " << fixed << setprecision(6) << suggested << " BTC (paying " << total_input - amount - max(change, 0.0) << " BTC)" << endl;
+
         cout << "Creating transaction..." << endl;
-        auto result = mempool.add_transaction(tx, utxo_manager);
+        if(tx_id)
+            *tx_id = tx.tx_id;
+        return mempool.add_transaction(move(tx), utxo_manager);
+    }
+
+    void create_transaction_ui() 
+    {
+        string sender, recipient;
+        double amount;
+        cout << "Enter sender: ";
+        cin >> sender;
+        
+        double balance = utxo_manager.get_balance(sender);
+        cout << "Available balance: " << balance << " BTC" << endl;
+        fee_estimator.display_estimates();
+        
+        if(balance == 0) //sender is broke
+        {
+            cout << "Error: Sender has no balance." << endl;
+            return;
+        }
+
+        cout << "Enter recipient: ";
+        cin >> recipient;
+        cout << "Enter amount: ";
+        cin >> amount;
+
+        string tx_id;
+        auto result = create_transaction(sender, recipient, amount, &tx_id);
         cout << result.second << endl;
         if (result.first) {
-            cout << "Transaction ID: " << tx.tx_id << endl;
+            cout << "Transaction ID: " << tx_id << endl;
             cout << "Transaction added to mempool." << endl;
             cout << "Mempool now has " << mempool.transactions.size() << " transactions." << endl;
         }
     }
 
+    //the blocks the range selects, as boxes or JSON lines, in large buffered writes
+    ViewPage view_blocks(const ViewRange& range, RenderFormat format = RENDER_TEXT, ostream& out = cout)
+    {
+        return renderer.render_blocks(blockchain, range, format, out);
+    }
+
+    //the UTXOs the range selects, as a table or JSON lines, in large buffered writes
+    ViewPage view_utxos(const ViewRange& range, RenderFormat format = RENDER_TEXT, ostream& out = cout)
+    {
+        return renderer.render_utxos(utxo_manager, range, format, out);
+    }
+
+    //shows a text view page_size records at a time for as long as the user asks for more;
+    //JSON is meant for redirection and goes out in one piece
+    template<typename View>
+    void page_through(ViewRange range, RenderFormat format, size_t page_size, View view)
+    {
+        if(format == RENDER_JSON)
+        {
+            view(range, format);
+            return;
+        }
+        range.limit = page_size;
+        while(true)
+        {
+            ViewPage page = view(range, format);
+            range.offset += page.shown;
+            if(!page.more)
+                break;
+            cout << "-- " << range.offset << " shown, n for the next page, q to stop: ";
+            string answer;
+            if(!(cin >> answer) || answer != "n")
+                break;
+        }
+    }
+
+    static RenderFormat read_format()
+    {
+        string format;
+        cin >> format;
+        return format == "json" ? RENDER_JSON : RENDER_TEXT;
+    }
+
     void display_blockchain() {
         if (blockchain.empty()) {
             cout << "Blockchain is empty. No blocks mined yet." << endl;
             return;
         }
-        for (int i = 0; i < blockchain.size(); ++i) {
-            int box_width = blockchain[i].display();
-            if (i < blockchain.size() - 1) {
-                int dashes = box_width - 2; 
-                int center_pos = box_width / 2 - 3;
-                cout << endl; 
-                cout << "  " << string(center_pos - 1, ' ') << "|" << endl;
-                cout << "  " << string(center_pos - 1, ' ') << "v" << endl;
+        ViewRange range;
+        cout << "Enter first and last height (0 0 for the whole chain) and format (text/json): ";
+        if (!(cin >> range.from_height >> range.to_height)) {
+            cin.clear();
+            cin.ignore(1000, '\n');
+            return;
+        }
+        if (range.to_height <= 0)
+            range.to_height = INT_MAX;
+        RenderFormat format = read_format();
+        page_through(range, format, 10, [this](const ViewRange& r, RenderFormat f) { return view_blocks(r, f); });
+    }
+
+    void display_utxos() {
+        ViewRange range;
+        cout << "Enter owner (* for all) and format (text/json): ";
+        cin >> range.owner;
+        if (range.owner == "*")
+            range.owner.clear();
+        RenderFormat format = read_format();
+        page_through(range, format, 50, [this](const ViewRange& r, RenderFormat f) { return view_utxos(r, f); });
+        if (format == RENDER_TEXT)
+            utxo_manager.rich_list.display(5);
+    }
+
+    //per-owner balances, ranks and total supply of the current UTXO set
+    const RichList& rich_list() const
+    {
+        return utxo_manager.rich_list;
+    }
+
+    //the block reward the halving schedule gives the block at height (heights start at 1)
+    double scheduled_reward(int height) const
+    {
+        double reward = config.block_reward;
+        for(int mined = 1; mined < height; ++mined)
+        {
+            if(Halving::halves(mined, k))
+                reward /= 2;
+        }
+        return reward;
+    }
+
+    //walks the chain checking every block's reward against the halving schedule, then the
+    //supply tracked by the UTXO set against genesis plus all the rewards issued
+    pair<bool, string> audit_supply() const
+    {
+        double reward = config.block_reward;
+        double issued = genesis_supply;
+        for(size_t i = 0; i < blockchain.size(); ++i)
+        {
+            const Block& block = blockchain[i];
+            if(fabs(block.block_reward - reward) > epsilon)
+                return {false, "Error: block " + to_string(block.block_height) + " pays a reward of " + to_string(block.block_reward) + " BTC, the schedule allows " + to_string(reward) + " BTC"};
+            issued += reward;
+            if(Halving::halves(i + 1, k))
+                reward /= 2;
+        }
+        double supply = utxo_manager.rich_list.total_supply();
+        if(fabs(supply - issued) > epsilon * max(1.0, issued))
+            return {false, "Error: supply is " + to_string(supply) + " BTC, genesis and block rewards add up to " + to_string(issued) + " BTC"};
+        return {true, "Supply of " + to_string(supply) + " BTC matches the schedule over " + to_string(blockchain.size()) + " blocks"};
+    }
+
+    //combined hash of the UTXO set and the mempool contents
+    crypto::SetHash state_hash() const
+    {
+        crypto::SetHash utxos = utxo_manager.state_hash(), pool = mempool.state_hash();
+        crypto::Digest d = crypto::Sha512().update(utxos.data(), utxos.size()).update(pool.data(), pool.size()).final();
+        crypto::SetHash out;
+        memcpy(out.data(), d.data(), out.size());
+        return out;
+    }
+
+    //logs every transaction creation, mining and pruning request from here on;
+    //start before anything else happens so a replay begins from the same state
+    pair<bool, string> start_recording(const string& path)
+    {
+        return recorder.open(path, config);
+    }
+
+    //closes the log with the final state hash
+    void stop_recording()
+    {
+        if(!recorder.is_open())
+            return;
+        mempool.expire();
+        SimEvent e;
+        e.type = EVENT_END;
+        e.hash = state_hash();
+        record(e);
+        recorder.close();
+    }
+
+    //re-executes a recorded run with its seed and recorded clock, output suppressed, and
+    //checks the final state hash against the one in the log
+    static pair<bool, string> replay(const string& path, ReplayStats* stats = nullptr)
+    {
+        EventLogReader reader;
+        SimConfig config;
+        auto opened = reader.open(path, config);
+        if(!opened.first)
+            return opened;
+
+        auto started = chrono::steady_clock::now();
+        streambuf* saved = cout.rdbuf(nullptr);
+        BasicSimulator sim(config.gas_fee, config.block_reward, config.mempool_maxsize, config.k, config.mempool_max_bytes, config.mempool_expiry, config.seed);
+        sim.replay_time = 0;
+        SimEvent e;
+        string error;
+        size_t events = 1;
+        pair<bool, string> result = {false, "Error: " + path + " has no end record"};
+        while(reader.next(e, error))
+        {
+            events++;
+            sim.replay_time = e.time;
+            if(e.type == EVENT_CREATE_TX)
+                sim.create_transaction(e.sender, e.recipient, e.amount);
+            else if(e.type == EVENT_MINE)
+                sim.mine_next_block(e.miner);
+            else if(e.type == EVENT_PRUNING)
+                sim.enable_pruning(e.depth);
+            else if(e.type == EVENT_END)
+            {
+                sim.mempool.expire();
+                crypto::SetHash actual = sim.state_hash();
+                if(actual == e.hash)
+                    result = {true, "Replay matches, state hash " + crypto::to_hex(actual.data(), 8) + "..."};
+                else
+                    result = {false, "Error: state hash mismatch, log has " + crypto::to_hex(e.hash.data(), 8) + "... replay got " + crypto::to_hex(actual.data(), 8) + "..."};
+                break;
             }
-            
         }
+        cout.rdbuf(saved);
+        cout.clear();
+        if(!error.empty())
+            result = {false, error};
+        if(stats)
+        {
+            stats->events = events;
+            stats->elapsed_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            stats->state_hash = sim.state_hash();
+        }
+        return result;
+    }
+
+    //switches to a competing branch that forks after fork_height; branch blocks must pay
+    //the scheduled reward for their height, and mining continues the schedule from the new tip
+    pair<bool, string> reorganize(int fork_height, const vector<Block>& branch)
+    {
+        for(const auto& block : branch)
+        {
+            double reward = scheduled_reward(block.block_height);
+            if(fabs(block.block_reward - reward) > epsilon)
+                return {false, "Block " + to_string(block.block_height) + " pays a reward of " + to_string(block.block_reward) + " BTC, the schedule allows " + to_string(reward) + " BTC"};
+        }
+        vector<Block> old_blocks;
+        if(fork_height >= 0 && fork_height < (int)blockchain.size())
+            old_blocks.assign(blockchain.begin() + fork_height, blockchain.end());
+        auto result = reorganize_chain(blockchain, undo_log, fork_height, branch, utxo_manager, mempool);
+        if(result.first && indexing)
+        {
+            for(auto it = old_blocks.rbegin(); it != old_blocks.rend(); ++it)
+                chain_index.unindex_block(*it);
+            for(const auto& block : branch)
+                chain_index.index_block(block);
+        }
+        if(result.first)
+        {
+            counter = blockchain.size();
+            block_reward = scheduled_reward(counter + 1);
+        }
+        if(result.first && prune_depth > 0)
+            prune_chain(blockchain, undo_log, prune_depth, &last_pruned);
+        return result;
+    }
+
+    //exposes the menu actions as JSON-RPC methods; the server runs each call, or a whole
+    //batch of calls, under its state_mutex
+    void register_rpc_methods(RpcServer& server)
+    {
+        auto text = [](const Json& params, const char* key, string& out) {
+            const Json* v = params.get(key);
+            if(!v || !v->is_string() || v->text.empty())
+                return false;
+            out = v->text;
+            return true;
+        };
+        auto number = [](const Json& params, const char* key, double& out) {
+            const Json* v = params.get(key);
+            if(!v || !v->is_number())
+                return false;
+            out = v->number;
+            return true;
+        };
+        //optional count-like param: absent leaves out unchanged, anything but an integer
+        //from 0 to max is answered with an invalid-params error
+        auto whole = [](const Json& params, const char* key, double max, double& out) {
+            const Json* v = params.get(key);
+            if(!v)
+                return;
+            if(!v->is_number() || !(v->number >= 0 && v->number <= max) || v->number != floor(v->number))
+                throw RpcServer::InvalidParams(string(key) + " must be an integer from 0 to " + Json(max).dump());
+            out = v->number;
+        };
+        const double max_whole = 9007199254740992.0; //2^53, every integer up to it is exact
+        auto submit = [this, text, number](const Json& params, Json& result) -> pair<bool, string> {
+            string sender, recipient, tx_id;
+            double amount;
+            if(!text(params, "sender", sender) || !text(params, "recipient", recipient) || !number(params, "amount", amount))
+                return {false, "Error: expected sender, recipient and amount"};
+            auto status = create_transaction(sender, recipient, amount, &tx_id);
+            if(status.first)
+            {
+                result = Json::object();
+                result.set("tx_id", tx_id).set("message", status.second);
+            }
+            return status;
+        };
+
+        server.register_method("submit_transaction", submit);
+        //each transaction is admitted or rejected on its own, in order
+        server.register_method("submit_transactions", [submit](const Json& params, Json& result) -> pair<bool, string> {
+            const Json* list = params.is_array() ? &params : params.get("transactions");
+            if(!list || !list->is_array())
+                return {false, "Error: expected an array of transactions"};
+            result = Json::array();
+            for(const auto& item : list->items)
+            {
+                Json accepted;
+                auto status = submit(item, accepted);
+                Json entry = accepted.is_object() ? move(accepted) : Json::object();
+                entry.set("accepted", status.first);
+                if(!status.first)
+                    entry.set("message", status.second);
+                result.push(move(entry));
+            }
+            return {true, ""};
+        });
+        server.register_method("get_balance", [this, text](const Json& params, Json& result) -> pair<bool, string> {
+            string owner;
+            if(!text(params, "owner", owner))
+                return {false, "Error: expected owner"};
+            result = Json::object();
+            result.set("owner", owner).set("balance", utxo_manager.get_balance(owner)).set("rank", utxo_manager.rich_list.rank(owner));
+            return {true, ""};
+        });
+        //the params.count (default 10) largest holders, richest first
+        server.register_method("get_rich_list", [this, whole, max_whole](const Json& params, Json& result) -> pair<bool, string> {
+            double count = 10;
+            whole(params, "count", max_whole, count);
+            Json holders = Json::array();
+            size_t rank = 1;
+            for(const auto& h : utxo_manager.rich_list.top((size_t)count))
+            {
+                Json entry = Json::object();
+                entry.set("rank", rank++).set("owner", h.first).set("balance", h.second);
+                holders.push(move(entry));
+            }
+            result = Json::object();
+            result.set("supply", utxo_manager.rich_list.total_supply()).set("owners", utxo_manager.rich_list.num_holders()).set("holders", move(holders));
+            return {true, ""};
+        });
+        server.register_method("get_supply", [this](const Json&, Json& result) -> pair<bool, string> {
+            auto audit = audit_supply();
+            result = Json::object();
+            result.set("supply", utxo_manager.rich_list.total_supply()).set("block_reward", block_reward)
+                  .set("blocks", blockchain.size()).set("matches_schedule", audit.first).set("message", audit.second);
+            return {true, ""};
+        });
+        //optional offset and limit of a paginated listing
+        auto page = [whole, max_whole](const Json& params, ViewRange& range) {
+            double offset = 0, limit = -1;
+            whole(params, "offset", max_whole, offset);
+            whole(params, "limit", max_whole, limit);
+            range.offset = offset;
+            if(limit >= 0)
+                range.limit = limit;
+        };
+        //every UTXO, or only those of params.owner, paginated by params.offset and params.limit
+        server.register_method("list_utxos", [this, text, page](const Json& params, Json& result) -> pair<bool, string> {
+            ViewRange range;
+            text(params, "owner", range.owner);
+            page(params, range);
+            result = Json::array();
+            visit_utxos(utxo_manager, range, [&result](const UTXO& u) { result.push(utxo_to_json(u)); });
+            return {true, ""};
+        });
+        server.register_method("get_mempool", [this](const Json&, Json& result) -> pair<bool, string> {
+            mempool.expire();
+            Json txs = Json::array();
+            for(const auto& tx : mempool.transactions)
+                txs.push(transaction_to_json(tx));
+            result = Json::object();
+            result.set("size", mempool.transactions.size()).set("bytes", mempool.total_bytes).set("transactions", move(txs));
+            return {true, ""};
+        });
+        server.register_method("mine_block", [this, text](const Json& params, Json& result) -> pair<bool, string> {
+            string miner;
+            if(!text(params, "miner", miner))
+                return {false, "Error: expected miner"};
+            Block block = mine_next_block(miner);
+            if(block.block_height == -1)
+                return {false, "No transactions to mine."};
+            result = block_to_json(block);
+            return {true, ""};
+        });
+        //heights start at 1
+        server.register_method("get_block", [this, number](const Json& params, Json& result) -> pair<bool, string> {
+            double height;
+            if(!number(params, "height", height))
+                return {false, "Error: expected height"};
+            if(height < 1 || height > blockchain.size() || height != floor(height))
+                return {false, "Error: no block at height " + Json(height).dump()};
+            result = block_to_json(blockchain[(size_t)height - 1]);
+            return {true, ""};
+        });
+        //blocks with heights from params.from to params.to (both optional), paginated by
+        //params.offset and params.limit
+        server.register_method("get_blocks", [this, whole, page](const Json& params, Json& result) -> pair<bool, string> {
+            ViewRange range;
+            double from = range.from_height, to = range.to_height;
+            whole(params, "from", INT_MAX, from);
+            whole(params, "to", INT_MAX, to);
+            page(params, range);
+            range.from_height = from;
+            range.to_height = to;
+            result = Json::array();
+            visit_blocks(blockchain, range, [&result](const Block& b) { result.push(block_to_json(b)); });
+            return {true, ""};
+        });
+        server.register_method("get_block_count", [this](const Json&, Json& result) -> pair<bool, string> {
+            result = Json(blockchain.size());
+            return {true, ""};
+        });
+    }
+
+    //answers JSON-RPC requests until the server is stopped
+    void serve(RpcServer& server)
+    {
+        register_rpc_methods(server);
+        server.run();
+        if(!fee_estimates_path.empty())
+            fee_estimator.save(fee_estimates_path);
     }
 
     void run() {
         cout << "=== Bitcoin Transaction Simulator ===" << endl;
         cout << "Initial UTXOs (Genesis Block):" << endl;
-        utxo_manager.display();
+        view_utxos(ViewRange());
 
         while (true) 
         {
@@ -184,11 +742,12 @@ public:
                 cin.ignore(1000, '\n');
                 continue;
             }
+            mempool.expire(); //release outpoints held by stale transactions
 
             if(choice == 1) 
                 create_transaction_ui();
             else if (choice == 2) 
-                utxo_manager.display();
+                display_utxos();
             else if (choice == 3) 
                 mempool.display();
             else if (choice == 4) 
@@ -196,24 +755,24 @@ public:
                 string miner;
                 cout << "Enter miner name: ";
                 cin >> miner;
-                counter++;
-                Block new_block = mine_block(miner, mempool, utxo_manager, blockchain.size() + 1, block_reward);
-                if(counter%k==0)
-                block_reward/=2;
-                if (new_block.block_height != -1) {
-                    blockchain.push_back(new_block);
-                }
+                mine_next_block(miner);
             } 
             else if (choice == 5)
                 display_blockchain();
             else if (choice == 6) 
                 run_test_scenarios(k, gas_fee);
             else if (choice == 7) 
+            {
+                if(!fee_estimates_path.empty())
+                    fee_estimator.save(fee_estimates_path);
                 break;
+            }
             else 
                 cout << "Invalid choice." << endl;
         }
     }
 };
 
+typedef BasicSimulator<> Simulator;
+
 #endif
@@ -0,0 +1,121 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include<bits/stdc++.h>
+using namespace std;
+
+//hierarchical timing wheel: LEVELS wheels of 64 slots, level l slots span 64^l ticks
+//scheduling is O(1); advancing fires due entries and cascades higher levels down
+//when the lower wheel wraps, so each entry is touched at most LEVELS times
+template<typename T>
+class TimerWheel
+{
+    static const int BITS = 6;
+    static const int SLOTS = 1 << BITS;
+    static const int LEVELS = 4;
+
+    struct Entry
+    {
+        T value;
+        int64_t expiry;
+    };
+
+    vector<vector<Entry>> slots[LEVELS];
+    int64_t current; //last tick processed
+    size_t count;
+
+    void place(Entry&& e)
+    {
+        int64_t delta = e.expiry - current;
+        if(delta <= 0)
+        {
+            //already due, fire on the next tick
+            e.expiry = current + 1;
+            delta = 1;
+        }
+        for(int level = 0; level < LEVELS; ++level)
+        {
+            int64_t span = (int64_t)1 << (BITS * (level + 1));
+            if(delta < span || level == LEVELS - 1)
+            {
+                int64_t at = min(e.expiry, current + span - 1); //far timers wait in the last slot of the top wheel
+                size_t slot = (at >> (BITS * level)) & (SLOTS - 1);
+                slots[level][slot].push_back(move(e));
+                return;
+            }
+        }
+    }
+
+public:
+    TimerWheel(int64_t start_tick = 0)
+    {
+        for(int level = 0; level < LEVELS; ++level)
+            slots[level].assign(SLOTS, vector<Entry>());
+        current = start_tick;
+        count = 0;
+    }
+
+    void schedule(T value, int64_t expiry_tick)
+    {
+        Entry e = {move(value), expiry_tick};
+        place(move(e));
+        count++;
+    }
+
+    //moves time forward to now and appends every value that came due
+    void advance(int64_t now, vector<T>& expired)
+    {
+        if(count == 0)
+        {
+            current = max(current, now);
+            return;
+        }
+        while(current < now)
+        {
+            current++;
+            //cascade: when a level wraps, redistribute the next slot of the level above
+            for(int level = 1; level < LEVELS; ++level)
+            {
+                if((current & (((int64_t)1 << (BITS * level)) - 1)) != 0)
+                    break;
+                size_t slot = (current >> (BITS * level)) & (SLOTS - 1);
+                vector<Entry> moving;
+                moving.swap(slots[level][slot]);
+                for(auto& e : moving)
+                {
+                    if(e.expiry <= current)
+                    {
+                        expired.push_back(move(e.value));
+                        count--;
+                    }
+                    else
+                        place(move(e));
+                }
+            }
+            auto& due = slots[0][current & (SLOTS - 1)];
+            for(size_t i = 0; i < due.size(); ++i)
+            {
+                if(due[i].expiry <= current)
+                {
+                    expired.push_back(move(due[i].value));
+                    count--;
+                }
+                else
+                    place(move(due[i])); //parked far timer, not due yet
+            }
+            due.clear();
+            if(count == 0)
+            {
+                current = now;
+                break;
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+};
+
+#endif
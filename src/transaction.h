@@ -1,3 +1,6 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
 #include<bits/stdc++.h>
 #include"utxo_manager.h"
 using namespace std;
@@ -8,6 +11,7 @@ struct Input
     string prev_tx_id;
     int index;
     string owner; 
+    string signature; //64-byte Ed25519 signature by owner over transaction_digest()
 };
 
 //output format
@@ -28,3 +32,43 @@ struct Transaction
         return tx_id == other.tx_id;
     }
 };
+
+//serialized size in bytes (length-prefixed strings, 8-byte numbers, 64-byte signature slot per input)
+//fee rates are fee / tx_size
+size_t tx_size(const Transaction& tx)
+{
+    size_t size = 8 + tx.tx_id.size() + 8 + 8; // id, input count, output count
+    for (const auto& input : tx.inputs)
+        size += 8 + input.prev_tx_id.size() + 8 + 64;
+    for (const auto& output : tx.outputs)
+        size += 8 + 8 + output.address.size();
+    return size;
+}
+
+//heap bytes a string of this length owns, zero while it fits in the small-string buffer
+//based on size() rather than capacity() so the figure does not drift as copies move around
+size_t string_heap_bytes(const string& s)
+{
+    static const size_t inline_capacity = string().capacity();
+    return s.size() > inline_capacity ? s.size() + 1 : 0;
+}
+
+//memory a resident transaction holds: the object, its vectors and their strings
+size_t tx_memory_usage(const Transaction& tx)
+{
+    size_t bytes = sizeof(Transaction) + string_heap_bytes(tx.tx_id);
+    bytes += tx.inputs.size() * sizeof(Input);
+    for (const auto& input : tx.inputs)
+        bytes += string_heap_bytes(input.prev_tx_id) + string_heap_bytes(input.owner) + string_heap_bytes(input.signature);
+    bytes += tx.outputs.size() * sizeof(Output);
+    for (const auto& output : tx.outputs)
+        bytes += string_heap_bytes(output.address);
+    return bytes;
+}
+
+double fee_rate(const Transaction& tx)
+{
+    return tx.fee / tx_size(tx);
+}
+
+#endif
@@ -1,4 +1,9 @@
+#ifndef UTXO_MANAGER_H
+#define UTXO_MANAGER_H
+
 #include<bits/stdc++.h>
+#include"crypto.h"
+#include"rich_list.h"
 using namespace std;
  //utxo structure 
 struct UTXO 
@@ -16,29 +21,144 @@ struct UTXO
     }
 };
 
+//hash for (tx_id, index) keys in unordered containers, also over (string_view, int) with
+//the same value, so it can serve heterogeneous lookups
+struct OutpointHash
+{
+    using is_transparent = void;
+
+    size_t operator()(const pair<string, int>& outpoint) const
+    {
+        return (*this)(pair<string_view, int>(outpoint.first, outpoint.second));
+    }
+
+    size_t operator()(const pair<string_view, int>& outpoint) const
+    {
+        return hash<string_view>()(outpoint.first) * 31 + hash<int>()(outpoint.second);
+    }
+};
+
+//equality for (tx_id, index) keys that also accepts (string_view, int)
+struct OutpointEqual
+{
+    using is_transparent = void;
+
+    template<typename A, typename B>
+    bool operator()(const pair<A, int>& a, const pair<B, int>& b) const
+    {
+        return a.second == b.second && string_view(a.first) == string_view(b.first);
+    }
+};
+
+//ordering for (tx_id, index) keys that also accepts (string_view, int), so lookups
+//with a view or a literal do not build a temporary string
+struct OutpointLess
+{
+    using is_transparent = void;
+
+    template<typename A, typename B>
+    bool operator()(const pair<A, int>& a, const pair<B, int>& b) const
+    {
+        int c = string_view(a.first).compare(string_view(b.first));
+        return c < 0 || (c == 0 && a.second < b.second);
+    }
+};
+
+//storage policies for BasicUTXOManager: the container behind utxo_set and how a
+//(tx_id, index) lookup is made against it. Both are in memory; the disk-backed set is
+//UTXOCache (utxo_store.h), which has the same UTXO-set interface and is passed to the
+//mempool and block functions directly rather than through a policy
+struct OrderedUTXOMap //sorted by outpoint, lookups by view without building a key
+{
+    typedef map<pair<string, int>, UTXO, OutpointLess> type;
+
+    template<typename Map>
+    static auto find(Map& m, string_view tx_id, int index)
+    {
+        return m.find(pair<string_view, int>(tx_id, index));
+    }
+};
+
+struct HashedUTXOMap //O(1) average lookups, unordered iteration
+{
+    typedef unordered_map<pair<string, int>, UTXO, OutpointHash, OutpointEqual> type;
+
+    //a heterogeneous lookup where the library has one (C++20); under C++17 one key per
+    //thread is reused, so only a tx_id longer than any looked up before allocates
+    template<typename Map>
+    static auto find(Map& m, string_view tx_id, int index)
+    {
+#if __cpp_lib_generic_unordered_lookup
+        return m.find(pair<string_view, int>(tx_id, index));
+#else
+        static thread_local pair<string, int> key;
+        key.first.assign(tx_id.data(), tx_id.size());
+        key.second = index;
+        return m.find(key);
+#endif
+    }
+};
+
 //utxo manager
-class UTXOManager 
+template<typename Storage = OrderedUTXOMap>
+class BasicUTXOManager 
 {
 public:
-    map<pair<string, int>, UTXO> utxo_set; //(tx_id , index ) -> (amount , owner )
+    typename Storage::type utxo_set; //(tx_id , index ) -> (amount , owner )
+    crypto::MuHash set_hash; //commitment to utxo_set, kept in step by add_utxo/remove_utxo
+    RichList rich_list; //per-owner balances and supply, also kept in step by add_utxo/remove_utxo
 
-    void add_utxo(string tx_id, int index, double amount, string owner) //add utxo to utxo set
+    //bytes committed to set_hash for one utxo
+    static string utxo_commitment(const UTXO& utxo)
     {
-        utxo_set[{tx_id, index}] = {tx_id, index, amount, owner};
+        string out;
+        uint64_t bits;
+        memcpy(&bits, &utxo.amount, sizeof(bits));
+        out += to_string(utxo.tx_id.size()) + ":" + utxo.tx_id;
+        out += "|" + to_string(utxo.index) + "|" + to_string(bits) + "|";
+        out += to_string(utxo.owner.size()) + ":" + utxo.owner;
+        return out;
     }
 
-    void remove_utxo(string tx_id, int index) //remove utxo from utxo set
+    void add_utxo(string tx_id, int index, double amount, string owner) //add utxo to utxo set, strings are moved in
     {
-        utxo_set.erase({tx_id, index});
+        auto ins = utxo_set.try_emplace({tx_id, index});
+        UTXO& slot = ins.first->second;
+        if(!ins.second) //overwritten
+        {
+            string old = utxo_commitment(slot);
+            set_hash.remove((const uint8_t*)old.data(), old.size());
+            rich_list.debit(slot.owner, slot.amount);
+        }
+        rich_list.credit(owner, amount);
+        slot = {move(tx_id), index, amount, move(owner)};
+        string c = utxo_commitment(slot);
+        set_hash.insert((const uint8_t*)c.data(), c.size());
     }
 
-    double get_balance(string owner) //total balance of owner
+    void remove_utxo(string_view tx_id, int index) //remove utxo from utxo set
+    {
+        auto it = Storage::find(utxo_set, tx_id, index);
+        if(it == utxo_set.end())
+            return;
+        string c = utxo_commitment(it->second);
+        set_hash.remove((const uint8_t*)c.data(), c.size());
+        rich_list.debit(it->second.owner, it->second.amount);
+        utxo_set.erase(it);
+    }
+
+    //O(1) in the set size: equal sets give equal hashes whatever order they were built in
+    crypto::SetHash state_hash() const
+    {
+        return set_hash.finalize();
+    }
+
+    double get_balance(string_view owner) const //total balance of owner
     {
         double balance = 0;
         for(auto const& u : utxo_set) 
         {
-            auto key = u.first;
-            auto utxo = u.second;
+            const UTXO& utxo = u.second;
             if(utxo.owner == owner) 
             {
                 balance += utxo.amount;
@@ -47,18 +167,24 @@ public:
         return balance;
     }
 
-    bool exists(string tx_id, int index) 
+    //lookup without building a key string, nullptr if absent
+    const UTXO* find_utxo(string_view tx_id, int index) const
     {
-        return utxo_set.find({tx_id, index}) != utxo_set.end();
+        auto it = Storage::find(utxo_set, tx_id, index);
+        return it == utxo_set.end() ? nullptr : &it->second;
     }
 
-    vector<UTXO> get_utxos_for_owner(string owner) 
+    bool exists(string_view tx_id, int index) const
+    {
+        return find_utxo(tx_id, index) != nullptr;
+    }
+
+    vector<UTXO> get_utxos_for_owner(string_view owner) const
     {
         vector<UTXO> result;
         for(auto const& u : utxo_set) 
         {
-            auto key = u.first;
-            auto utxo = u.second;
+            const UTXO& utxo = u.second;
             if (utxo.owner == owner) 
             {
                 result.push_back(utxo);
@@ -67,15 +193,18 @@ public:
         return result;
     }
 
-    void display() 
+    void display() const
     {
         cout << "\n--- Current UTXO Set ---" << endl;
         cout << left << setw(20) << "TX ID" << setw(10) << "Index" << setw(15) << "Amount" << setw(15) << "Owner" << endl;
         for(auto const& u : utxo_set) 
         {
-            auto key = u.first;
-            auto utxo = u.second;
+            const UTXO& utxo = u.second;
             cout << left << setw(20) << utxo.tx_id << setw(10) << utxo.index << setw(15) << fixed << setprecision(3) << utxo.amount << setw(15) << utxo.owner << endl;
         }
     }
 };
+
+typedef BasicUTXOManager<> UTXOManager;
+
+#endif
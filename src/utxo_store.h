@@ -0,0 +1,716 @@
+#ifndef UTXO_STORE_H
+#define UTXO_STORE_H
+
+#include<bits/stdc++.h>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#include"block.h"
+#include"crypto.h"
+using namespace std;
+
+//persistent UTXO set in two files:
+//  <path>.idx  open-addressing hash table mapped with mmap: a header and 16-byte slots
+//              (key hash, record offset), linear probing, power-of-two capacity
+//  <path>.dat  append-only records: len, index, amount, tx_id and owner strings
+//overwritten and erased records stay in .dat until the table is rebuilt on growth
+class UTXODiskStore
+{
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t capacity;
+        uint64_t count;
+        uint64_t tombstones;
+        uint64_t data_end;
+    };
+
+    struct Slot
+    {
+        uint64_t hash; //0 empty, 1 erased, otherwise key hash with the top bit set
+        uint64_t offset;
+    };
+
+    static const uint64_t MAGIC = 0x7574786f73746f01ULL; //format tag and version
+    static const uint64_t EMPTY = 0;
+    static const uint64_t ERASED = 1;
+    static const size_t HEADER_SIZE = 64;
+
+    string path;
+    int idx_fd = -1;
+    int dat_fd = -1;
+    uint8_t* mapped = nullptr;
+    size_t mapped_size = 0;
+
+    Header* header() const
+    {
+        return (Header*)mapped;
+    }
+
+    Slot* slots() const
+    {
+        return (Slot*)(mapped + HEADER_SIZE);
+    }
+
+    static uint64_t key_hash(const string& tx_id, int index)
+    {
+        uint64_t h = crypto::siphash24(0x7574786f5f6b3030ULL, 0x73746f72655f6b31ULL, tx_id);
+        h ^= (uint64_t)(uint32_t)index * 0x9e3779b97f4a7c15ULL;
+        return h | (1ULL << 63);
+    }
+
+    static bool open_files(const string& base, int& idx, int& dat)
+    {
+        idx = ::open((base + ".idx").c_str(), O_RDWR | O_CREAT, 0644);
+        dat = ::open((base + ".dat").c_str(), O_RDWR | O_CREAT, 0644);
+        return idx >= 0 && dat >= 0;
+    }
+
+    bool map_index(int fd, uint64_t capacity, bool init)
+    {
+        size_t size = HEADER_SIZE + capacity * sizeof(Slot);
+        if(init && ftruncate(fd, size) != 0)
+            return false;
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+            return false;
+        mapped = (uint8_t*)p;
+        mapped_size = size;
+        if(init)
+        {
+            memset(mapped, 0, size);
+            header()->magic = MAGIC;
+            header()->capacity = capacity;
+        }
+        return true;
+    }
+
+    void unmap()
+    {
+        if(mapped)
+            munmap(mapped, mapped_size);
+        mapped = nullptr;
+        mapped_size = 0;
+    }
+
+    bool read_record(uint64_t offset, UTXO& out) const
+    {
+        uint32_t fixed[2];
+        double amount;
+        uint32_t lens[2];
+        if(pread(dat_fd, fixed, 8, offset) != 8 || pread(dat_fd, &amount, 8, offset + 8) != 8 || pread(dat_fd, lens, 8, offset + 16) != 8)
+            return false;
+        string buf(lens[0] + lens[1], '\0');
+        if(!buf.empty() && pread(dat_fd, &buf[0], buf.size(), offset + 24) != (ssize_t)buf.size())
+            return false;
+        out.index = (int)fixed[1];
+        out.amount = amount;
+        out.tx_id = buf.substr(0, lens[0]);
+        out.owner = buf.substr(lens[0]);
+        return true;
+    }
+
+    uint64_t append_record(int fd, uint64_t& end, const UTXO& utxo)
+    {
+        string rec(24 + utxo.tx_id.size() + utxo.owner.size(), '\0');
+        uint32_t len = rec.size(), index = (uint32_t)utxo.index;
+        uint32_t lens[2] = {(uint32_t)utxo.tx_id.size(), (uint32_t)utxo.owner.size()};
+        memcpy(&rec[0], &len, 4);
+        memcpy(&rec[4], &index, 4);
+        memcpy(&rec[8], &utxo.amount, 8);
+        memcpy(&rec[16], lens, 8);
+        memcpy(&rec[24], utxo.tx_id.data(), utxo.tx_id.size());
+        memcpy(&rec[24 + utxo.tx_id.size()], utxo.owner.data(), utxo.owner.size());
+        uint64_t offset = end;
+        if(pwrite(fd, rec.data(), rec.size(), offset) != (ssize_t)rec.size())
+            return UINT64_MAX;
+        end += rec.size();
+        return offset;
+    }
+
+    //slot holding the key, or the slot an insert should use; reads records to rule out hash collisions
+    Slot* find_slot(const string& tx_id, int index, uint64_t h, bool for_insert) const
+    {
+        uint64_t mask = header()->capacity - 1;
+        Slot* first_free = nullptr;
+        for(uint64_t i = h & mask;; i = (i + 1) & mask)
+        {
+            Slot* s = &slots()[i];
+            if(s->hash == EMPTY)
+                return for_insert ? (first_free ? first_free : s) : nullptr;
+            if(s->hash == ERASED)
+            {
+                if(!first_free)
+                    first_free = s;
+                continue;
+            }
+            if(s->hash == h)
+            {
+                UTXO u;
+                reads++;
+                if(read_record(s->offset, u) && u.tx_id == tx_id && u.index == index)
+                    return s;
+            }
+        }
+    }
+
+    //rewrites both files with only live records into a table of new_capacity slots
+    bool rebuild(uint64_t new_capacity)
+    {
+        string tmp = path + ".tmp";
+        int new_idx, new_dat;
+        //on failure the old files stay in use, the half-built ones are closed and removed
+        auto discard = [&]() {
+            if(new_idx >= 0)
+                ::close(new_idx);
+            if(new_dat >= 0)
+                ::close(new_dat);
+            unlink((tmp + ".idx").c_str());
+            unlink((tmp + ".dat").c_str());
+            return false;
+        };
+        if(!open_files(tmp, new_idx, new_dat) || ftruncate(new_dat, 0) != 0)
+            return discard();
+        vector<UTXO> live;
+        for_each([&](const UTXO& u) { live.push_back(u); });
+
+        uint8_t* old_map = mapped;
+        size_t old_size = mapped_size;
+        mapped = nullptr;
+        if(!map_index(new_idx, new_capacity, true))
+        {
+            mapped = old_map;
+            return discard();
+        }
+        uint64_t end = 0;
+        for(const auto& u : live)
+        {
+            uint64_t h = key_hash(u.tx_id, u.index);
+            uint64_t mask = new_capacity - 1;
+            uint64_t i = h & mask;
+            while(slots()[i].hash != EMPTY)
+                i = (i + 1) & mask;
+            slots()[i].hash = h;
+            slots()[i].offset = append_record(new_dat, end, u);
+            if(slots()[i].offset == UINT64_MAX)
+            {
+                unmap();
+                mapped = old_map;
+                mapped_size = old_size;
+                return discard();
+            }
+        }
+        header()->count = live.size();
+        header()->data_end = end;
+        munmap(old_map, old_size);
+        msync(mapped, mapped_size, MS_SYNC);
+        fdatasync(new_dat);
+        rename((tmp + ".idx").c_str(), (path + ".idx").c_str());
+        rename((tmp + ".dat").c_str(), (path + ".dat").c_str());
+        ::close(idx_fd);
+        ::close(dat_fd);
+        idx_fd = new_idx;
+        dat_fd = new_dat;
+        return true;
+    }
+
+public:
+    mutable uint64_t reads = 0; //records read from .dat
+    uint64_t writes = 0; //records appended to .dat by put(), rebuild copies not counted
+
+    UTXODiskStore() {}
+    UTXODiskStore(const UTXODiskStore&) = delete;
+    UTXODiskStore& operator=(const UTXODiskStore&) = delete;
+
+    ~UTXODiskStore()
+    {
+        close();
+    }
+
+    //opens or creates the store, initial_capacity is rounded up to a power of two
+    pair<bool, string> open(const string& base_path, uint64_t initial_capacity = 1024)
+    {
+        close();
+        path = base_path;
+        if(!open_files(path, idx_fd, dat_fd))
+            return {false, "Cannot open UTXO store at " + path};
+        struct stat st;
+        fstat(idx_fd, &st);
+        if(st.st_size == 0)
+        {
+            uint64_t capacity = 16;
+            while(capacity < initial_capacity)
+                capacity <<= 1;
+            if(ftruncate(dat_fd, 0) != 0 || !map_index(idx_fd, capacity, true))
+                return {false, "Cannot initialize UTXO store at " + path};
+            return {true, "Created UTXO store at " + path};
+        }
+        Header h;
+        if(pread(idx_fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || h.magic != MAGIC
+            || (uint64_t)st.st_size != HEADER_SIZE + h.capacity * sizeof(Slot))
+        {
+            close();
+            return {false, "Corrupt UTXO store index at " + path + ".idx"};
+        }
+        if(!map_index(idx_fd, h.capacity, false))
+            return {false, "Cannot map UTXO store index at " + path + ".idx"};
+        return {true, "Opened UTXO store at " + path + " (" + to_string(h.count) + " UTXOs)"};
+    }
+
+    void close()
+    {
+        if(mapped)
+            sync();
+        unmap();
+        if(idx_fd >= 0)
+            ::close(idx_fd);
+        if(dat_fd >= 0)
+            ::close(dat_fd);
+        idx_fd = dat_fd = -1;
+    }
+
+    bool is_open() const
+    {
+        return mapped != nullptr;
+    }
+
+    uint64_t size() const
+    {
+        return mapped ? header()->count : 0;
+    }
+
+    bool get(const string& tx_id, int index, UTXO& out) const
+    {
+        Slot* s = find_slot(tx_id, index, key_hash(tx_id, index), false);
+        return s && read_record(s->offset, out);
+    }
+
+    //inserts or overwrites
+    bool put(const UTXO& utxo)
+    {
+        Header* hd = header();
+        if((hd->count + hd->tombstones + 1) * 4 > hd->capacity * 3)
+        {
+            uint64_t capacity = hd->capacity;
+            while((hd->count + 1) * 2 > capacity)
+                capacity <<= 1;
+            if(!rebuild(capacity))
+                return false;
+            hd = header();
+        }
+        uint64_t h = key_hash(utxo.tx_id, utxo.index);
+        Slot* s = find_slot(utxo.tx_id, utxo.index, h, true);
+        uint64_t offset = append_record(dat_fd, hd->data_end, utxo);
+        if(offset == UINT64_MAX)
+            return false;
+        writes++;
+        if(s->hash != h)
+        {
+            if(s->hash == ERASED)
+                hd->tombstones--;
+            hd->count++;
+            s->hash = h;
+        }
+        s->offset = offset;
+        return true;
+    }
+
+    bool erase(const string& tx_id, int index)
+    {
+        Slot* s = find_slot(tx_id, index, key_hash(tx_id, index), false);
+        if(!s)
+            return false;
+        s->hash = ERASED;
+        header()->count--;
+        header()->tombstones++;
+        return true;
+    }
+
+    //makes every completed put/erase durable
+    bool sync()
+    {
+        return msync(mapped, mapped_size, MS_SYNC) == 0 && fdatasync(dat_fd) == 0;
+    }
+
+    //visits every stored UTXO in table order
+    void for_each(const function<void(const UTXO&)>& visit) const
+    {
+        for(uint64_t i = 0; i < header()->capacity; ++i)
+        {
+            const Slot& s = slots()[i];
+            UTXO u;
+            if(s.hash > ERASED && read_record(s.offset, u))
+                visit(u);
+        }
+    }
+};
+
+struct UTXOCacheEntry
+{
+    UTXO utxo;
+    bool spent; //spent since it was loaded, the store still has it
+    bool dirty; //differs from the store
+    bool fresh; //the store has never seen it, spending it just drops the entry
+};
+
+struct UTXOCacheStats
+{
+    uint64_t hits;
+    uint64_t misses; //lookups that went to the store
+    uint64_t flushes;
+    uint64_t written; //UTXOs written to the store by flushes
+    uint64_t erased; //UTXOs erased from the store by flushes
+    uint64_t fresh_spends; //created and spent between flushes, never written
+};
+
+//write-back cache over a UTXODiskStore, the UTXO view used when the set outgrows RAM
+//changes stay in memory until flush(), which writes them as one batch; callers flush
+//at block boundaries. Clean entries are evicted past capacity, dirty ones wait for the flush.
+//It has the UTXO-set interface of BasicUTXOManager (find_utxo, exists, add_utxo, remove_utxo,
+//state_hash, rich_list, get_balance, get_utxos_for_owner), so Mempool::add_transaction,
+//mine_block and the block connect/disconnect templates take it in place of the in-memory set.
+//Lookups load from the store and are const like the manager's.
+class UTXOCache
+{
+    //an outpoint as it was before a change made after checkpoint(), absent if not cached
+    struct JournalEntry
+    {
+        pair<string, int> outpoint;
+        bool cached;
+        UTXOCacheEntry before;
+    };
+
+    UTXODiskStore& store;
+    size_t capacity;
+    mutable unordered_map<pair<string, int>, UTXOCacheEntry, OutpointHash> entries;
+    size_t dirty_count = 0;
+    mutable UTXOCacheStats counters = {0, 0, 0, 0, 0, 0};
+    crypto::MuHash set_hash; //commitment to the whole set, store and cache together
+    bool journaling = false;
+    vector<JournalEntry> journal;
+    size_t checkpoint_dirty = 0;
+    uint64_t checkpoint_fresh_spends = 0;
+
+    //keeps set_hash and rich_list in step as utxo joins (insert) or leaves the set
+    void account(const UTXO& utxo, bool insert)
+    {
+        string c = UTXOManager::utxo_commitment(utxo);
+        if(insert)
+        {
+            set_hash.insert((const uint8_t*)c.data(), c.size());
+            rich_list.credit(utxo.owner, utxo.amount);
+        }
+        else
+        {
+            set_hash.remove((const uint8_t*)c.data(), c.size());
+            rich_list.debit(utxo.owner, utxo.amount);
+        }
+    }
+
+    void log_change(const string& tx_id, int index)
+    {
+        if(!journaling)
+            return;
+        auto it = entries.find({tx_id, index});
+        if(it == entries.end())
+            journal.push_back({{tx_id, index}, false, UTXOCacheEntry()});
+        else
+            journal.push_back({it->first, true, it->second});
+    }
+
+    //evicts a few clean entries, keeps the cost per lookup bounded
+    void make_room() const
+    {
+        if(entries.size() < capacity)
+            return;
+        int scanned = 0;
+        for(auto it = entries.begin(); it != entries.end() && entries.size() >= capacity && scanned < 16; ++scanned)
+        {
+            if(it->second.dirty)
+                ++it;
+            else
+                it = entries.erase(it);
+        }
+    }
+
+    //cached entry for the outpoint (loading it from the store on a miss), nullptr if unknown
+    UTXOCacheEntry* fetch(string_view tx_id, int index) const
+    {
+        auto it = entries.find({string(tx_id), index});
+        if(it != entries.end())
+        {
+            counters.hits++;
+            return &it->second;
+        }
+        counters.misses++;
+        return load(tx_id, index);
+    }
+
+    //reads an uncached outpoint from the store into a clean entry, nullptr if not stored
+    UTXOCacheEntry* load(string_view tx_id, int index) const
+    {
+        UTXO u;
+        if(!store.get(string(tx_id), index, u))
+            return nullptr;
+        make_room();
+        UTXOCacheEntry& e = entries[{u.tx_id, index}];
+        e = {u, false, false, false};
+        return &e;
+    }
+
+    void mark_dirty(UTXOCacheEntry& e)
+    {
+        if(!e.dirty)
+            dirty_count++;
+        e.dirty = true;
+    }
+
+public:
+    RichList rich_list; //per-owner balances and supply of the whole set
+
+    //the set hash and rich list are built with one pass over the store
+    UTXOCache(UTXODiskStore& store, size_t capacity = 100000) : store(store)
+    {
+        this->capacity = max<size_t>(capacity, 1);
+        if(store.is_open())
+            store.for_each([&](const UTXO& u) { account(u, true); });
+    }
+
+    bool get_utxo(string_view tx_id, int index, UTXO& out) const
+    {
+        const UTXO* u = find_utxo(tx_id, index);
+        if(!u)
+            return false;
+        out = *u;
+        return true;
+    }
+
+    //nullptr if absent; the pointer is valid until the next call on the cache
+    const UTXO* find_utxo(string_view tx_id, int index) const
+    {
+        UTXOCacheEntry* e = fetch(tx_id, index);
+        return e && !e->spent ? &e->utxo : nullptr;
+    }
+
+    bool exists(string_view tx_id, int index) const
+    {
+        return find_utxo(tx_id, index) != nullptr;
+    }
+
+    //a new UTXO is fresh unless the outpoint is cached or stored, which is then overwritten
+    //as in UTXOManager; a stored one is loaded first so the hash, balances and a later erase
+    //see the old record
+    void add_utxo(const string& tx_id, int index, double amount, const string& owner)
+    {
+        auto it = entries.find({tx_id, index});
+        if(it == entries.end() && load(tx_id, index))
+            it = entries.find({tx_id, index});
+        log_change(tx_id, index);
+        if(it == entries.end())
+        {
+            make_room();
+            UTXOCacheEntry& e = entries[{tx_id, index}];
+            e = {{tx_id, index, amount, owner}, false, false, true};
+            mark_dirty(e);
+            account(e.utxo, true);
+            return;
+        }
+        UTXOCacheEntry& e = it->second;
+        if(!e.spent)
+            account(e.utxo, false);
+        e.utxo = {tx_id, index, amount, owner};
+        e.spent = false;
+        mark_dirty(e);
+        account(e.utxo, true);
+    }
+
+    bool remove_utxo(string_view tx_id, int index)
+    {
+        UTXOCacheEntry* e = fetch(tx_id, index);
+        if(!e || e->spent)
+            return false;
+        log_change(e->utxo.tx_id, index);
+        account(e->utxo, false);
+        if(e->fresh)
+        {
+            // never reached the store, nothing to erase there
+            if(e->dirty)
+                dirty_count--;
+            entries.erase({string(tx_id), index});
+            counters.fresh_spends++;
+            return true;
+        }
+        e->spent = true;
+        mark_dirty(*e);
+        return true;
+    }
+
+    //O(1): equal sets give equal hashes, also against an in-memory UTXOManager
+    crypto::SetHash state_hash() const
+    {
+        return set_hash.finalize();
+    }
+
+    double get_balance(string_view owner) const
+    {
+        return rich_list.balance(string(owner));
+    }
+
+    //one pass over the store, with cached changes laid over it
+    vector<UTXO> get_utxos_for_owner(string_view owner) const
+    {
+        vector<UTXO> result;
+        store.for_each([&](const UTXO& u) {
+            auto it = entries.find({u.tx_id, u.index});
+            if(it == entries.end())
+            {
+                if(u.owner == owner)
+                    result.push_back(u);
+            }
+            else if(!it->second.spent && it->second.utxo.owner == owner)
+                result.push_back(it->second.utxo);
+        });
+        for(const auto& e : entries)
+        {
+            if(e.second.fresh && !e.second.spent && e.second.utxo.owner == owner)
+                result.push_back(e.second.utxo);
+        }
+        return result;
+    }
+
+    //from here until flush() or rollback(), add_utxo/remove_utxo record the entries they
+    //change, so rollback() can put back exactly what was there: flags, counters and hash
+    void checkpoint()
+    {
+        journaling = true;
+        journal.clear();
+        checkpoint_dirty = dirty_count;
+        checkpoint_fresh_spends = counters.fresh_spends;
+    }
+
+    void rollback()
+    {
+        for(auto it = journal.rbegin(); it != journal.rend(); ++it)
+        {
+            auto cur = entries.find(it->outpoint);
+            if(cur != entries.end())
+            {
+                if(!cur->second.spent)
+                    account(cur->second.utxo, false);
+                entries.erase(cur);
+            }
+            if(it->cached)
+            {
+                entries[it->outpoint] = it->before;
+                if(!it->before.spent)
+                    account(it->before.utxo, true);
+            }
+        }
+        dirty_count = checkpoint_dirty;
+        counters.fresh_spends = checkpoint_fresh_spends;
+        journal.clear();
+        journaling = false;
+    }
+
+    //writes all dirty entries to the store in one batch and syncs it once
+    //an entry whose write fails stays dirty and cached, so the next flush retries it
+    bool flush()
+    {
+        journal.clear();
+        journaling = false;
+        bool ok = true;
+        size_t still_dirty = 0;
+        for(auto it = entries.begin(); it != entries.end();)
+        {
+            UTXOCacheEntry& e = it->second;
+            if(e.dirty)
+            {
+                if(e.spent)
+                {
+                    store.erase(it->first.first, it->first.second);
+                    counters.erased++;
+                    it = entries.erase(it);
+                    continue;
+                }
+                if(store.put(e.utxo))
+                {
+                    counters.written++;
+                    e.dirty = e.fresh = false;
+                }
+                else
+                {
+                    ok = false;
+                    still_dirty++;
+                }
+            }
+            ++it;
+        }
+        dirty_count = still_dirty;
+        for(auto it = entries.begin(); it != entries.end() && entries.size() > capacity;)
+        {
+            if(it->second.dirty)
+                ++it;
+            else
+                it = entries.erase(it);
+        }
+        counters.flushes++;
+        return store.sync() && ok;
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    size_t dirty() const
+    {
+        return dirty_count;
+    }
+
+    UTXOCacheStats stats() const
+    {
+        return counters;
+    }
+
+    void display_stats() const
+    {
+        uint64_t lookups = counters.hits + counters.misses;
+        cout << "\n--- UTXO Cache ---" << endl;
+        cout << left << setw(24) << "Cached entries" << entries.size() << " / " << capacity << " (" << dirty_count << " dirty)" << endl;
+        cout << left << setw(24) << "Hits / misses" << counters.hits << " / " << counters.misses;
+        if(lookups)
+            cout << " (" << fixed << setprecision(1) << 100.0 * counters.hits / lookups << "% hit)" << defaultfloat;
+        cout << endl;
+        cout << left << setw(24) << "Flushes" << counters.flushes << endl;
+        cout << left << setw(24) << "Written / erased" << counters.written << " / " << counters.erased << endl;
+        cout << left << setw(24) << "Never written" << counters.fresh_spends << endl;
+        cout << left << setw(24) << "UTXOs on disk" << store.size() << endl;
+    }
+};
+
+//applies a block to the cached view and flushes it; on a missing input the cache is
+//rolled back to its state before the block and nothing is flushed
+pair<bool, string> connect_block(const Block& block, UTXOCache& view)
+{
+    view.checkpoint();
+    for(const auto& tx : block.transactions)
+    {
+        for(const auto& input : tx.inputs)
+        {
+            if(!view.remove_utxo(input.prev_tx_id, input.index))
+            {
+                view.rollback();
+                return {false, "Block " + to_string(block.block_height) + ": input UTXO does not exist: " + input.prev_tx_id + ":" + to_string(input.index)};
+            }
+        }
+        for(size_t i = 0; i < tx.outputs.size(); ++i)
+            view.add_utxo(tx.tx_id, i, tx.outputs[i].amount, tx.outputs[i].address);
+    }
+    view.add_utxo(coinbase_tx_id(block.block_height), 0, block.block_reward + block.total_fees, block.miner);
+    if(!view.flush())
+        return {false, "Block " + to_string(block.block_height) + ": UTXO store flush failed"};
+    return {true, "Block " + to_string(block.block_height) + " connected"};
+}
+
+#endif
@@ -0,0 +1,469 @@
+#ifndef STRESS_TESTS_H
+#define STRESS_TESTS_H
+
+#include <bits/stdc++.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "tests.h"
+
+using namespace std;
+
+/*
+Randomized stress suite: generated workloads over thousands of owners and long
+mempool/mining sequences, with invariants checked after every block. Each scenario runs
+in its own forked process, so scenarios run in parallel, their output is discarded and a
+hang cannot stall the suite. A scenario fails if it exceeds its time budget, which is set
+far above its normal running time so only a complexity regression trips it.
+Every failure message names the seed; ./simulator --stress SEED reruns the suite with it.
+*/
+
+typedef pair<bool, string> StressStatus;
+
+// a UTXO set, mempool and chain driven by a seeded random workload
+struct StressWorld {
+    mt19937_64 rng;
+    string tag;
+    vector<string> owners;
+    UTXOManager utxos;
+    Mempool mempool;
+    ChainIndex index;
+    vector<Block> chain;
+    vector<BlockUndo> undo;
+    vector<double> rewards; // per block
+    unordered_map<string, double> genesis; // owner -> genesis amount
+    double expected_total = 0; // genesis value plus every block reward
+    vector<pair<string, int>> spendable; // confirmed outpoints, refreshed after every block
+    int next_tx = 0;
+
+    StressWorld(uint64_t seed, const string& tag, int num_owners, int mempool_size, size_t mempool_bytes = 0)
+        : rng(seed), tag(tag), mempool(mempool_size, 0.01, mempool_bytes) {
+        for (int i = 0; i < num_owners; ++i) {
+            owners.push_back("owner_" + to_string(i));
+            double amount = 1 + (double)(rng() % 10000) / 100;
+            utxos.add_utxo("genesis", i, amount, owners.back());
+            index.add_genesis_output("genesis", i, amount, owners.back());
+            genesis[owners.back()] += amount;
+            expected_total += amount;
+        }
+        refresh();
+    }
+
+    size_t pick(size_t n) { return rng() % n; }
+
+    const string& random_owner() { return owners[pick(owners.size())]; }
+
+    double random_fee_fraction() { return 0.001 + (double)(rng() % 1000) / 50000; }
+
+    void refresh() {
+        spendable.clear();
+        for (const auto& u : utxos.utxo_set) spendable.push_back(u.first);
+    }
+
+    // up to three distinct confirmed outpoints that no mempool transaction spends yet
+    vector<pair<string, int>> free_inputs() {
+        vector<pair<string, int>> inputs;
+        int want = 1 + pick(3);
+        for (int attempt = 0; attempt < 12 && (int)inputs.size() < want && !spendable.empty(); ++attempt) {
+            const auto& op = spendable[pick(spendable.size())];
+            if (!utxos.exists(op.first, op.second) || mempool.spent_utxos.count(op)) continue;
+            if (find(inputs.begin(), inputs.end(), op) == inputs.end()) inputs.push_back(op);
+        }
+        return inputs;
+    }
+
+    // an outpoint some mempool transaction already spends
+    bool pending_input(pair<string, int>& op) {
+        if (mempool.transactions.empty()) return false;
+        const Transaction& tx = mempool.transactions[pick(mempool.transactions.size())];
+        op = {tx.inputs[0].prev_tx_id, tx.inputs[0].index};
+        return true;
+    }
+
+    // spends the inputs to one to three random owners, keeping fee_fraction as fee
+    Transaction spend(const vector<pair<string, int>>& inputs, double fee_fraction) {
+        Transaction tx;
+        tx.tx_id = tag + "_tx_" + to_string(next_tx++);
+        double total = 0;
+        for (const auto& op : inputs) {
+            const UTXO* u = utxos.find_utxo(op.first, op.second);
+            tx.inputs.push_back({op.first, op.second, u->owner});
+            total += u->amount;
+        }
+        double left = total * (1 - fee_fraction);
+        int outs = 1 + pick(3);
+        for (int i = 0; i < outs; ++i) {
+            double amount = i + 1 == outs ? left : left * (double)(1 + pick(99)) / 100;
+            tx.outputs.push_back({amount, random_owner()});
+            left -= amount;
+        }
+        return tx;
+    }
+
+    // mines up to num_txs transactions, false if the mempool had nothing to mine
+    bool mine(int num_txs, double reward) {
+        BlockUndo u;
+        Block block = mine_block(random_owner(), mempool, utxos, chain.size() + 1, reward, num_txs, &u);
+        if (block.block_height == -1) return false;
+        expected_total += reward;
+        rewards.push_back(reward);
+        index.index_block(block);
+        chain.push_back(move(block));
+        undo.push_back(move(u));
+        refresh();
+        return true;
+    }
+
+    StressStatus fail(const string& what) const {
+        return {false, "height " + to_string(chain.size()) + ": " + what};
+    }
+
+    // mempool bookkeeping: every resident transaction owns exactly the spent_utxos locks of
+    // its inputs, those inputs are confirmed, and the size/fee indexes agree with the pool
+    StressStatus check_mempool() const {
+        size_t inputs = 0, bytes = 0;
+        for (size_t i = 0; i < mempool.transactions.size(); ++i) {
+            const Transaction& tx = mempool.transactions[i];
+            auto pos = mempool.position.find(tx.tx_id);
+            if (pos == mempool.position.end() || pos->second != i) return fail("position index out of date for " + tx.tx_id);
+            for (const auto& in : tx.inputs) {
+                auto lock = mempool.spent_utxos.find({in.prev_tx_id, in.index});
+                if (lock == mempool.spent_utxos.end() || lock->second != tx.tx_id) return fail("input of " + tx.tx_id + " is not locked by it");
+                if (!utxos.exists(in.prev_tx_id, in.index)) return fail("mempool input is not in the UTXO set: " + tx.tx_id);
+            }
+            inputs += tx.inputs.size();
+            bytes += tx_memory_usage(tx);
+        }
+        if (mempool.spent_utxos.size() != inputs) return fail("orphaned spent_utxos locks: " + to_string(mempool.spent_utxos.size()) + " locks for " + to_string(inputs) + " inputs");
+        if (mempool.total_bytes != bytes) return fail("total_bytes " + to_string(mempool.total_bytes) + " != " + to_string(bytes));
+        if (mempool.by_fee_rate.size() != mempool.transactions.size() || mempool.position.size() != mempool.transactions.size())
+            return fail("fee rate or position index size differs from the pool");
+        if (mempool.max_size > 0 && mempool.transactions.size() > (size_t)mempool.max_size) return fail("mempool above max_size");
+        return {true, ""};
+    }
+
+    // value conservation, per-owner balances against the address index and get_balance,
+    // and the recorded UTXO hash of the tip; full_hash also rebuilds the MuHash from scratch
+    StressStatus check_invariants(bool full_hash) {
+        auto m = check_mempool();
+        if (!m.first) return m;
+
+        double total = 0;
+        unordered_map<string, double> balance;
+        for (const auto& u : utxos.utxo_set) {
+            total += u.second.amount;
+            balance[u.second.owner] += u.second.amount;
+        }
+        if (fabs(total - expected_total) > 1e-6 * max(1.0, expected_total))
+            return fail("value not conserved: " + to_string(total) + " in UTXOs, expected " + to_string(expected_total));
+
+        for (const auto& owner : owners) {
+            double indexed = genesis.count(owner) ? genesis.at(owner) : 0;
+            for (const auto& e : index.history(owner)) indexed += e.delta;
+            double held = balance.count(owner) ? balance[owner] : 0;
+            if (fabs(indexed - held) > 1e-6 * max(1.0, held)) return fail("address index balance of " + owner + " is " + to_string(indexed) + ", UTXOs hold " + to_string(held));
+        }
+        if (balance.size() > owners.size()) return fail("UTXOs owned by unknown addresses");
+        for (int i = 0; i < 3; ++i) {
+            const string& owner = random_owner();
+            double held = balance.count(owner) ? balance[owner] : 0;
+            if (fabs(utxos.get_balance(owner) - held) > 1e-9 * max(1.0, held)) return fail("get_balance(" + owner + ") disagrees with the UTXO set");
+        }
+
+        if (!chain.empty() && utxos.state_hash() != chain.back().utxo_hash) return fail("tip UTXO hash differs from the set");
+        if (full_hash) {
+            UTXOManager rebuilt;
+            for (const auto& u : utxos.utxo_set) rebuilt.add_utxo(u.second.tx_id, u.second.index, u.second.amount, u.second.owner);
+            if (rebuilt.state_hash() != utxos.state_hash()) return fail("incremental UTXO hash differs from a rebuilt one");
+        }
+        return {true, ""};
+    }
+};
+
+/*
+Long mining sequence over 5000 owners: random payments fill a bounded mempool that is
+mined 40 transactions at a time, with halving rewards; double spends of pending outpoints
+must be rejected.
+*/
+static StressStatus stress_mining_sequence(uint64_t seed) {
+    StressWorld w(seed, "mining_sequence", 5000, 300);
+    double reward = 6.25;
+    for (int block = 1; block <= 150; ++block) {
+        for (int i = 0; i < 60; ++i) {
+            auto inputs = w.free_inputs();
+            if (!inputs.empty()) w.mempool.add_transaction(w.spend(inputs, w.random_fee_fraction()), w.utxos);
+        }
+        for (int i = 0; i < 5; ++i) {
+            pair<string, int> op;
+            if (!w.pending_input(op)) break;
+            auto r = w.mempool.add_transaction(w.spend({op}, 0.5), w.utxos);
+            if (r.first) return w.fail("double spend of a pending outpoint was accepted");
+        }
+        auto m = w.check_mempool();
+        if (!m.first) return m;
+        if (!w.mine(40, reward)) return w.fail("nothing to mine");
+        if (block % 50 == 0) reward /= 2;
+        auto check = w.check_invariants(block % 25 == 0);
+        if (!check.first) return check;
+    }
+    return {true, to_string(w.chain.size()) + " blocks, " + to_string(w.next_tx) + " transactions"};
+}
+
+/*
+Small mempool under pressure with replace-by-fee on: conflicting spends with random fees,
+count and byte limits evicting constantly; the mempool is checked after every operation.
+*/
+static StressStatus stress_eviction_rbf(uint64_t seed) {
+    StressWorld w(seed, "eviction_rbf", 2000, 40, 12000);
+    w.mempool.replace_by_fee = true;
+    for (int block = 1; block <= 100; ++block) {
+        for (int i = 0; i < 40; ++i) {
+            pair<string, int> op;
+            bool conflict = w.pick(2) == 0 && w.pending_input(op);
+            string replaced;
+            if (conflict) replaced = w.mempool.spent_utxos[op];
+            auto inputs = conflict ? vector<pair<string, int>>{op} : w.free_inputs();
+            if (inputs.empty()) continue;
+            Transaction tx = w.spend(inputs, conflict ? w.random_fee_fraction() * 10 : w.random_fee_fraction());
+            string id = tx.tx_id;
+            auto r = w.mempool.add_transaction(move(tx), w.utxos);
+            if (conflict && r.first && w.mempool.position.count(replaced)) return w.fail("replacement accepted but " + replaced + " still resident");
+            auto m = w.check_mempool();
+            if (!m.first) return m;
+        }
+        w.mine(10, 6.25);
+        auto check = w.check_invariants(block % 25 == 0);
+        if (!check.first) return check;
+    }
+    return {true, to_string(w.chain.size()) + " blocks, " + to_string(w.next_tx) + " transactions"};
+}
+
+/*
+Mines 60 blocks, disconnects all of them with their undo data (the UTXO hash must step back
+through every earlier state and the address index must follow), then reconnects them with
+connect_block, which checks each recorded UTXO hash.
+*/
+static StressStatus stress_reorg_roundtrip(uint64_t seed) {
+    StressWorld w(seed, "reorg_roundtrip", 3000, 200);
+    vector<crypto::SetHash> before;
+    for (int block = 1; block <= 60; ++block) {
+        for (int i = 0; i < 50; ++i) {
+            auto inputs = w.free_inputs();
+            if (!inputs.empty()) w.mempool.add_transaction(w.spend(inputs, w.random_fee_fraction()), w.utxos);
+        }
+        before.push_back(w.utxos.state_hash());
+        if (!w.mine(30, 6.25)) return w.fail("nothing to mine");
+    }
+    w.mempool.clear();
+    crypto::SetHash tip = w.utxos.state_hash();
+    vector<Block> blocks = w.chain;
+    vector<BlockUndo> undo = w.undo;
+    while (!w.chain.empty()) {
+        size_t h = w.chain.size() - 1;
+        disconnect_block(w.undo[h], w.utxos);
+        w.index.unindex_block(w.chain[h]);
+        w.expected_total -= w.rewards[h];
+        w.chain.pop_back();
+        w.undo.pop_back();
+        if (w.utxos.state_hash() != before[h]) return w.fail("disconnecting block " + to_string(h + 1) + " did not restore the earlier UTXO hash");
+        auto check = w.check_invariants(h % 20 == 0);
+        if (!check.first) return check;
+    }
+    for (size_t h = 0; h < blocks.size(); ++h) {
+        BlockUndo u;
+        auto r = connect_block(blocks[h], w.utxos, u);
+        if (!r.first) return w.fail("reconnect failed: " + r.second);
+        w.index.index_block(blocks[h]);
+        w.expected_total += w.rewards[h];
+        w.chain.push_back(blocks[h]);
+        w.undo.push_back(u);
+    }
+    auto check = w.check_invariants(true);
+    if (!check.first) return check;
+    if (w.utxos.state_hash() != tip) return w.fail("reconnected chain ends at a different UTXO hash");
+    return {true, to_string(blocks.size()) + " blocks disconnected and reconnected"};
+}
+
+/*
+Large blocks with in-block spend chains: parallel_connect_block must reach the same UTXO
+hash as connect_block, and an appended double spend must make both reject the block and
+leave their sets unchanged.
+*/
+static StressStatus stress_parallel_connect(uint64_t seed) {
+    StressWorld w(seed, "parallel_connect", 4000, 0);
+    for (int height = 1; height <= 4; ++height) {
+        UTXOManager work = w.utxos;
+        vector<pair<string, int>> available = w.spendable;
+        vector<Transaction> txs;
+        double fees = 0;
+        for (int i = 0; i < 4000 && available.size() > 2; ++i) {
+            vector<pair<string, int>> inputs;
+            for (int k = 1 + w.pick(2); k > 0; --k) {
+                size_t at = w.pick(available.size());
+                inputs.push_back(available[at]);
+                available[at] = available.back();
+                available.pop_back();
+            }
+            Transaction tx;
+            tx.tx_id = "parallel_" + to_string(height) + "_" + to_string(i);
+            double total = 0;
+            for (const auto& op : inputs) {
+                const UTXO* u = work.find_utxo(op.first, op.second);
+                tx.inputs.push_back({op.first, op.second, u->owner});
+                total += u->amount;
+                work.remove_utxo(op.first, op.second);
+            }
+            int outs = 1 + w.pick(3);
+            for (int o = 0; o < outs; ++o) {
+                tx.outputs.push_back({total * 0.99 / outs, w.random_owner()});
+                work.add_utxo(tx.tx_id, o, total * 0.99 / outs, tx.outputs.back().address);
+                available.push_back({tx.tx_id, o}); // later transactions may chain on it
+            }
+            tx.fee = total * 0.01;
+            fees += tx.fee;
+            txs.push_back(move(tx));
+        }
+        string miner = w.random_owner();
+        work.add_utxo(coinbase_tx_id(height), 0, 6.25 + fees, miner);
+        Block block = {height, miner, txs, fees, 6.25, "", work.state_hash(), compute_merkle_root(txs), 0, 0, false};
+
+        crypto::SetHash base = w.utxos.state_hash();
+        Block bad = block;
+        bad.transactions.push_back(bad.transactions.front());
+        bad.transactions.back().tx_id = "parallel_double_spend";
+        bad.utxo_hash = crypto::SetHash();
+        bad.merkle_root = crypto::SetHash();
+        UTXOManager serial = w.utxos;
+        ConcurrentUTXOSet shards(w.utxos);
+        BlockUndo u;
+        auto s = connect_block(bad, serial, u);
+        auto p = parallel_connect_block(bad, shards, 4);
+        if (s.first || p.first || s.second != p.second) return w.fail("double spend block: serial '" + s.second + "', parallel '" + p.second + "'");
+        if (serial.state_hash() != base || shards.state_hash() != base) return w.fail("rejected block changed the UTXO set");
+
+        s = connect_block(block, serial, u);
+        p = parallel_connect_block(block, shards, 4);
+        if (!s.first || !p.first) return w.fail("valid block rejected: " + s.second + " / " + p.second);
+        if (serial.state_hash() != shards.state_hash()) return w.fail("parallel and serial connection disagree");
+        w.utxos = move(serial);
+        w.refresh();
+    }
+    return {true, "4 blocks of up to 4000 transactions"};
+}
+
+struct StressScenario {
+    const char* name;
+    StressStatus (*run)(uint64_t seed);
+    double budget_ms;
+};
+
+/*
+Runs every scenario in a forked child, up to `parallel` at a time; a child that outlives
+its budget is killed and reported as a failure.
+*/
+static bool run_stress_suite(uint64_t seed, int parallel = 0) {
+    static const StressScenario scenarios[] = {
+        {"mining_sequence", stress_mining_sequence, 20000},
+        {"eviction_rbf", stress_eviction_rbf, 20000},
+        {"reorg_roundtrip", stress_reorg_roundtrip, 20000},
+        {"parallel_connect", stress_parallel_connect, 20000},
+    };
+    const size_t n = sizeof(scenarios) / sizeof(scenarios[0]);
+    if (parallel <= 0) parallel = max(1u, thread::hardware_concurrency());
+
+    struct Running {
+        pid_t pid;
+        int fd;
+        size_t scenario;
+        chrono::steady_clock::time_point started;
+        string output;
+    };
+    vector<Running> running;
+    size_t next = 0;
+    bool all_passed = true;
+    cout << "Stress seed " << seed << ", " << parallel << " at a time" << endl;
+
+    auto finish = [&](Running& r, bool timed_out) {
+        const StressScenario& sc = scenarios[r.scenario];
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - r.started).count();
+        int status = 0;
+        if (timed_out) kill(r.pid, SIGKILL);
+        waitpid(r.pid, &status, 0);
+        close(r.fd);
+        bool passed = !timed_out && r.output.size() > 0 && r.output[0] == 'P' && ms <= sc.budget_ms;
+        string detail = r.output.size() > 2 ? r.output.substr(2) : "";
+        if (timed_out) detail = "exceeded time budget";
+        else if (r.output.empty()) detail = WIFSIGNALED(status) ? "crashed with signal " + to_string(WTERMSIG(status)) : "no result";
+        else if (ms > sc.budget_ms) detail += ", over budget";
+        ostringstream msg;
+        msg << "Stress " << sc.name << ": " << detail << " (" << fixed << setprecision(0) << ms << " ms, budget " << sc.budget_ms << " ms, seed " << seed << ")";
+        expect(passed, msg.str());
+        all_passed = all_passed && passed;
+    };
+
+    while (next < n || !running.empty()) {
+        while (next < n && (int)running.size() < parallel) {
+            int fds[2];
+            if (pipe(fds) != 0) return false;
+            cout.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                int devnull = open("/dev/null", O_WRONLY);
+                dup2(devnull, STDOUT_FILENO);
+                StressStatus result = scenarios[next].run(seed + next);
+                string out = string(result.first ? "P" : "F") + " " + result.second;
+                ssize_t written = write(fds[1], out.data(), out.size());
+                (void)written;
+                _exit(0);
+            }
+            close(fds[1]);
+            if (pid < 0) {
+                close(fds[0]);
+                return false;
+            }
+            running.push_back({pid, fds[0], next++, chrono::steady_clock::now(), ""});
+        }
+
+        vector<pollfd> polls;
+        for (const auto& r : running) polls.push_back({r.fd, POLLIN, 0});
+        poll(polls.data(), polls.size(), 50);
+        for (size_t i = running.size(); i-- > 0;) {
+            Running& r = running[i];
+            bool done = false;
+            if (polls[i].revents) {
+                char buf[4096];
+                ssize_t got = read(r.fd, buf, sizeof(buf));
+                if (got > 0) r.output.append(buf, got);
+                else done = true;
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - r.started).count();
+            bool timed_out = !done && ms > scenarios[r.scenario].budget_ms;
+            if (done || timed_out) {
+                finish(r, timed_out);
+                running.erase(running.begin() + i);
+            }
+        }
+    }
+    return all_passed;
+}
+
+/*
+Test 30: Randomized Stress Suite
+- Thousands of owners, long mempool/mining sequences, eviction with replace-by-fee,
+  a full disconnect/reconnect round trip and large parallel-connected blocks
+- After every block: value conservation, no orphaned spent_utxos locks, balances agree
+  with the address index and get_balance, the UTXO hash matches the tip
+- Scenarios run in parallel processes, each within a time budget
+*/
+static bool test_stress_suite() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 30: Randomized Stress Suite" << endl;
+    bool passed = run_stress_suite(20261018);
+    cout << endl;
+    return passed;
+}
+
+#endif // STRESS_TESTS_H
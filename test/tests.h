@@ -2,6 +2,7 @@
 #define TESTS_H
 
 #include <bits/stdc++.h>
+#include <sys/resource.h>
 #include "../src/simulator.h"
 
 using namespace std;
@@ -14,6 +15,11 @@ static void expect(bool cond, const string &msg) {
     cout << (cond ? "[PASS] " : "[FAIL] ") << msg << endl;
 }
 
+// a check this build cannot make, reported instead of passing silently
+static void skip(const string &msg) {
+    cout << "[SKIP] " << msg << endl;
+}
+
 static Transaction* find_tx_in_mempool(Mempool &mp, const string &tx_id) {
     for (auto &t : mp.transactions) {
         if (t.tx_id == tx_id) return &t;
@@ -26,6 +32,31 @@ static string make_tx_id(const string &tag) {
     return "tx_" + tag + "_" + to_string(++counter);
 }
 
+// Heap allocation counter for the allocation tests. It replaces the global operator new for
+// the whole program, so it is only built into test builds: g++ -DSIM_COUNT_ALLOCATIONS ...
+// Kept out of line so the compiler does not pair an inlined malloc()/free() with new/delete
+static atomic<size_t> heap_allocations(0);
+
+#ifdef SIM_COUNT_ALLOCATIONS
+static const bool counting_allocations = true;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+#else
+static const bool counting_allocations = false;
+#endif
+
 /*
 Test 1: Basic Valid Transaction
 - Alice (50) sends 10 to Bob
@@ -158,6 +189,7 @@ Test 4: Mempool Double-Spend
 - TX1: Alice -> Bob (spends UTXO)
 - TX2: Alice -> Charlie (spends SAME UTXO)
 - Expected: TX1 accepted, TX2 rejected
+- A different transaction reusing TX1's id is rejected; mining then takes TX1 intact
 */
 static bool test_mempool_double_spend() {
         cout<<"\n=======================\n";
@@ -186,8 +218,20 @@ static bool test_mempool_double_spend() {
         expect(r2.second.find("UTXO already spent in mempool") != string::npos,
                "Error should indicate UTXO already spent in mempool");
     }
+
+    um.add_utxo("genesis", 1, 20.0, "Alice");
+    Transaction same_id;
+    same_id.tx_id = tx1.tx_id;
+    same_id.inputs.push_back({"genesis", 1, "Alice"});
+    same_id.outputs.push_back({15.0, "Dave"});
+    auto r3 = mp.add_transaction(same_id, um);
+    Block block = mine_block("Miner", mp, um, 1, 6.25);
+    bool unique = !r3.first && r3.second.find("already in mempool") != string::npos && block.transactions.size() == 1
+        && block.transactions[0].inputs.size() == 1 && block.transactions[0].outputs[0].address == "Bob"
+        && mp.transactions.empty() && mp.spent_utxos.empty() && um.exists("genesis", 1);
+    expect(unique, "A second transaction with a pooled tx_id should be rejected");
     cout << endl;
-    return r1.first && !r2.first;
+    return r1.first && !r2.first && unique;
 }
 
 /*
@@ -402,6 +446,7 @@ Test 11: Mempool Transaction Limit
 - Add transactions to mempool until it reaches MAX_MEMPOOL_SIZE
 - Attempt to add one more transaction
 - Expected: Transaction rejected with "Mempool is full" error
+- A transaction paying a higher fee rate still gets in by evicting the cheapest one
 */
 static bool test_mempool_transaction_limit() {
         cout<<"\n=======================\n";
@@ -436,8 +481,15 @@ static bool test_mempool_transaction_limit() {
     
     bool ok = txs_added > 0 && txs_added <= 5; 
     expect(ok, "Mempool should accept transactions up to limit, then reject");
+
+    Transaction richer;
+    richer.tx_id = "tx_limit_richer";
+    richer.inputs.push_back({"genesis", 9, "Alice"});
+    richer.outputs.push_back({40.0, "Bob"});
+    bool displaced = mp.add_transaction(richer, um).first && mp.transactions.size() == 5 && mp.position.count("tx_limit_richer");
+    expect(displaced, "A higher fee rate transaction should evict the lowest one from a full mempool");
     cout << endl;
-    return ok;
+    return ok && displaced;
 }
 
 /*
@@ -551,6 +603,1617 @@ static bool test_block_reward_halving(int k) {
     return true;
 }
 
+/*
+Test 14: Concurrent Pipeline
+- Four producers push transactions through the lock-free queue while a miner reads snapshots
+- A tiny queue that is never drained must push back on the producer
+- Expected: every submitted transaction admitted exactly once, full queue rejects
+*/
+static bool test_concurrent_pipeline() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 14: Concurrent Pipeline" << endl;
+    UTXOManager um;
+    Mempool mp(1000);
+    const int producers = 4, per_producer = 50;
+    for (int i = 0; i < producers * per_producer; i++) {
+        um.add_utxo("genesis", i, 10.0, "Alice");
+    }
+
+    TxPipeline pipeline(mp, um, 16);
+    pipeline.start();
+    atomic<bool> producing(true);
+    size_t max_seen = 0;
+    thread miner([&]() {
+        while (producing) {
+            auto snap = pipeline.snapshot_top();
+            max_seen = max(max_seen, snap->size());
+            this_thread::yield();
+        }
+    });
+    vector<thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < per_producer; i++) {
+                int idx = p * per_producer + i;
+                Transaction tx;
+                tx.tx_id = "tx_pipe_" + to_string(idx);
+                tx.inputs.push_back({"genesis", idx, "Alice"});
+                tx.outputs.push_back({10.0 - 0.001 * (idx % 7), "Bob"});
+                pipeline.submit_wait(tx);
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+    pipeline.stop();
+    producing = false;
+    miner.join();
+
+    PipelineStats s = pipeline.stats();
+    pipeline.display_stats();
+    bool all_admitted = s.admitted == (uint64_t)(producers * per_producer) && mp.transactions.size() == (size_t)(producers * per_producer);
+    expect(all_admitted, "All submitted transactions should be admitted to mempool");
+    expect(pipeline.snapshot_top()->size() == 4 && max_seen <= 4, "Miner snapshot should hold the top-fee set");
+
+    Block b = pipeline.mine("Miner", 1, 5.0);
+    bool mined = b.transactions.size() == 4 && pipeline.stats().txs_mined == 4;
+    expect(mined, "Mining through the pipeline should take the top transactions");
+
+    // backpressure: validator never started, queue of 2 fills up
+    UTXOManager um2;
+    Mempool mp2(1000);
+    TxPipeline stalled(mp2, um2, 2);
+    Transaction tx;
+    tx.tx_id = "tx_pipe_full";
+    bool a = stalled.submit(tx), b2 = stalled.submit(tx), c = stalled.submit(tx);
+    bool backpressure = a && b2 && !c && stalled.stats().rejected_full == 1;
+    expect(backpressure, "Full queue should reject submissions instead of growing");
+    cout << endl;
+    return all_admitted && mined && backpressure;
+}
+
+/*
+Test 15: Transaction and Address Indexes
+- Mine two blocks, indexing each as it is appended
+- Look up confirmed transactions and address histories
+- Bulk parallel rebuild must produce the same indexes
+- Rebuilding over a pruned block is refused and leaves the index empty
+*/
+static bool test_chain_index() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 15: Transaction and Address Indexes" << endl;
+    UTXOManager um;
+    Mempool mp;
+    ChainIndex index;
+    um.add_utxo("genesis", 0, 50.0, "Alice");
+    index.add_genesis_output("genesis", 0, 50.0, "Alice");
+    vector<Block> chain;
+
+    Transaction tx1;
+    tx1.tx_id = make_tx_id("index1");
+    tx1.inputs.push_back({"genesis", 0, "Alice"});
+    tx1.outputs.push_back({10.0, "Bob"});
+    tx1.outputs.push_back({39.0, "Alice"});
+    mp.add_transaction(tx1, um);
+    chain.push_back(mine_block("Miner", mp, um, 1, 5.0));
+    index.index_block(chain.back());
+
+    Transaction tx2;
+    tx2.tx_id = make_tx_id("index2");
+    tx2.inputs.push_back({tx1.tx_id, 0, "Bob"});
+    tx2.outputs.push_back({4.0, "Charlie"});
+    tx2.outputs.push_back({5.5, "Bob"});
+    mp.add_transaction(tx2, um);
+    chain.push_back(mine_block("Miner", mp, um, 2, 5.0));
+    index.index_block(chain.back());
+
+    TxLocation loc;
+    bool found = index.find_tx(tx2.tx_id, loc) && loc.height == 2 && loc.position == 0;
+    expect(found, "TX2 should be found at height 2, position 0");
+    bool coinbase = index.find_tx("coinbase_block_1", loc) && loc.height == 1 && loc.position == -1;
+    expect(coinbase, "Coinbase should be indexed with position -1");
+
+    const auto& bob = index.history("Bob");
+    bool bob_ok = bob.size() == 2 && fabs(bob[0].delta - 10.0) < EPS && fabs(bob[1].delta + 4.5) < EPS;
+    expect(bob_ok, "Bob's history should show +10 then -4.5");
+    const auto& alice = index.history("Alice");
+    bool alice_ok = alice.size() == 1 && fabs(alice[0].delta + 11.0) < EPS;
+    expect(alice_ok, "Alice's history should net -11 (spent 50, change 39)");
+
+    ChainIndex rebuilt;
+    rebuilt.add_genesis_output("genesis", 0, 50.0, "Alice");
+    rebuilt.rebuild(chain, 2);
+    bool same = rebuilt.tx_index.size() == index.tx_index.size() && rebuilt.history("Bob").size() == bob.size()
+        && fabs(rebuilt.history("Bob")[1].delta - bob[1].delta) < EPS && rebuilt.history("Miner").size() == 2;
+    expect(same, "Parallel rebuild should match incremental indexes");
+
+    chain[0].prune();
+    ChainIndex partial;
+    bool refused = !partial.rebuild(chain, 2) && partial.tx_index.empty() && partial.history("Miner").empty();
+    expect(refused, "Rebuilding a chain with a pruned block should be refused");
+    cout << endl;
+    return found && coinbase && bob_ok && alice_ok && same && refused;
+}
+
+/*
+Test 16: Chain Reorganization
+- Mine two blocks on the active chain, recording undo data
+- A competing 3-block branch forks after block 1 and confirms a different spend
+- Expected: UTXO set matches the new branch, orphaned tx back in mempool,
+  invalid branch leaves the chain untouched
+*/
+static bool test_chain_reorg() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 16: Chain Reorganization" << endl;
+    UTXOManager um;
+    Mempool mp;
+    um.add_utxo("genesis", 0, 50.0, "Alice");
+    um.add_utxo("genesis", 1, 30.0, "Bob");
+    vector<Block> chain;
+    vector<BlockUndo> undo_log;
+
+    Transaction tx1;
+    tx1.tx_id = make_tx_id("reorg1");
+    tx1.inputs.push_back({"genesis", 0, "Alice"});
+    tx1.outputs.push_back({49.0, "Bob"});
+    mp.add_transaction(tx1, um);
+    BlockUndo u1;
+    chain.push_back(mine_block("Miner", mp, um, 1, 5.0, 4, &u1));
+    undo_log.push_back(u1);
+    auto after_block1 = um.utxo_set;
+
+    Transaction tx2;
+    tx2.tx_id = make_tx_id("reorg2");
+    tx2.inputs.push_back({"genesis", 1, "Bob"});
+    tx2.outputs.push_back({29.0, "Charlie"});
+    mp.add_transaction(tx2, um);
+    BlockUndo u2;
+    chain.push_back(mine_block("Miner", mp, um, 2, 5.0, 4, &u2));
+    undo_log.push_back(u2);
+
+    // disconnect then connect the tip must round-trip the UTXO set
+    auto tip_state = um.utxo_set;
+    disconnect_block(undo_log[1], um);
+    bool undo_ok = um.utxo_set.size() == after_block1.size() && um.exists("genesis", 1) && !um.exists(tx2.tx_id, 0);
+    BlockUndo again;
+    connect_block(chain[1], um, again);
+    undo_ok = undo_ok && um.utxo_set.size() == tip_state.size() && um.exists(tx2.tx_id, 0);
+    expect(undo_ok, "Disconnect/connect of the tip should round-trip the UTXO set");
+
+    // competing branch: block 2' has no tx2, block 3' spends tx1's output (chained in one block)
+    Transaction tx3;
+    tx3.tx_id = make_tx_id("reorg3");
+    tx3.inputs.push_back({tx1.tx_id, 0, "Bob"});
+    tx3.outputs.push_back({48.0, "David"});
+    Transaction tx4;
+    tx4.tx_id = make_tx_id("reorg4");
+    tx4.inputs.push_back({tx3.tx_id, 0, "David"});
+    tx4.outputs.push_back({47.0, "Eve"});
+    vector<Block> branch;
+    branch.push_back({2, "Rival", {}, 0.0, 5.0, ""});
+    branch.push_back({3, "Rival", {tx3, tx4}, 2.0, 5.0, ""});
+
+    auto res = reorganize_chain(chain, undo_log, 1, branch, um, mp);
+    cout << res.second << endl;
+    bool switched = res.first && chain.size() == 3 && chain[2].miner == "Rival" && um.exists(tx4.tx_id, 0)
+        && !um.exists(tx3.tx_id, 0) && !um.exists(tx2.tx_id, 0) && um.exists("coinbase_block_3", 0) && um.utxo_set[{"coinbase_block_2", 0}].owner == "Rival";
+    expect(switched, "UTXO set should follow the longer branch");
+    bool readmitted = find_tx_in_mempool(mp, tx2.tx_id) != nullptr && um.exists("genesis", 1);
+    expect(readmitted, "Orphaned TX2 should be re-admitted to the mempool");
+
+    // a branch spending a missing UTXO must leave everything as it was
+    auto before = um.utxo_set;
+    Transaction bad;
+    bad.tx_id = make_tx_id("reorg_bad");
+    bad.inputs.push_back({"nowhere", 0, "Mallory"});
+    bad.outputs.push_back({1.0, "Mallory"});
+    vector<Block> bad_branch;
+    bad_branch.push_back({3, "Mallory", {}, 0.0, 5.0, ""});
+    bad_branch.push_back({4, "Mallory", {bad}, 0.0, 5.0, ""});
+    auto bad_res = reorganize_chain(chain, undo_log, 2, bad_branch, um, mp);
+    bool untouched = !bad_res.first && chain.size() == 3 && chain[2].miner == "Rival" && um.utxo_set.size() == before.size();
+    for (auto const& u : before) untouched = untouched && um.exists(u.first.first, u.first.second);
+    expect(untouched, "Invalid branch should be rejected without changing the chain");
+    cout << endl;
+    return undo_ok && switched && readmitted && untouched;
+}
+
+/*
+Test 17: Signature Validation
+- Alice signs a spend of her UTXO; Bob tries to spend Alice's UTXO with his key
+- A signed transaction is tampered with after signing
+- Mining must hit the signature cache instead of verifying again
+- Batch verification checks many transactions at once
+- A pending transaction that fails the recheck at mining time is evicted, not lost
+*/
+static bool test_signature_validation() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 17: Signature Validation" << endl;
+    UTXOManager um;
+    Mempool mp(100);
+    KeyStore keys;
+    SignatureVerifier verifier;
+    mp.verifier = &verifier;
+    verifier.register_key("Alice", keys.ensure("Alice"));
+    verifier.register_key("Bob", keys.ensure("Bob"));
+    for (int i = 0; i < 10; i++) {
+        um.add_utxo("genesis", i, 10.0, "Alice");
+    }
+
+    Transaction good;
+    good.tx_id = make_tx_id("signed");
+    good.inputs.push_back({"genesis", 0, "Alice"});
+    good.outputs.push_back({9.0, "Bob"});
+    keys.sign_transaction(good);
+    auto r1 = mp.add_transaction(good, um);
+    expect(r1.first, "Transaction signed by the UTXO owner should be accepted");
+
+    Transaction theft;
+    theft.tx_id = make_tx_id("theft");
+    theft.inputs.push_back({"genesis", 1, "Bob"});
+    theft.outputs.push_back({10.0, "Bob"});
+    keys.sign_transaction(theft);
+    auto r2 = mp.add_transaction(theft, um);
+    expect(!r2.first && r2.second.find("does not own") != string::npos, "Spending someone else's UTXO should be rejected");
+
+    Transaction forged = theft;
+    forged.inputs[0].owner = "Alice";
+    auto r3 = mp.add_transaction(forged, um);
+    expect(!r3.first && r3.second.find("Invalid signature") != string::npos, "Bob's signature on Alice's input should be rejected");
+
+    Transaction tampered;
+    tampered.tx_id = make_tx_id("tampered");
+    tampered.inputs.push_back({"genesis", 2, "Alice"});
+    tampered.outputs.push_back({9.0, "Bob"});
+    keys.sign_transaction(tampered);
+    tampered.outputs[0].address = "Mallory";
+    auto r4 = mp.add_transaction(tampered, um);
+    expect(!r4.first, "Outputs changed after signing should be rejected");
+
+    SigCacheStats before = verifier.stats();
+    Block b = mine_block("Miner", mp, um, 1, 5.0);
+    SigCacheStats after = verifier.stats();
+    bool cached = b.transactions.size() == 1 && after.verified == before.verified && after.hits == before.hits + 1;
+    expect(cached, "Mining should use the signature cache, not re-verify");
+
+    vector<Transaction> batch;
+    for (int i = 3; i < 10; i++) {
+        Transaction tx;
+        tx.tx_id = make_tx_id("batch");
+        tx.inputs.push_back({"genesis", i, "Alice"});
+        tx.outputs.push_back({9.5, "Bob"});
+        keys.sign_transaction(tx);
+        batch.push_back(tx);
+    }
+    batch.back().outputs[0].amount = 10.0;
+    auto results = verifier.check_batch(batch, um, 4);
+    bool batch_ok = true;
+    for (size_t i = 0; i + 1 < results.size(); i++) batch_ok = batch_ok && results[i].first;
+    batch_ok = batch_ok && !results.back().first;
+    expect(batch_ok, "Batch verification should accept valid and flag the altered transaction");
+
+    UTXOManager um2;
+    Mempool mp2(100);
+    mp2.verifier = &verifier;
+    verifier.register_key("Carol", keys.ensure("Carol"));
+    um2.add_utxo("recheck", 0, 10.0, "Alice");
+    um2.add_utxo("recheck", 1, 10.0, "Carol");
+    Transaction rich_fee, plain_fee;
+    rich_fee.tx_id = make_tx_id("recheck");
+    rich_fee.inputs.push_back({"recheck", 0, "Alice"});
+    rich_fee.outputs.push_back({8.0, "Bob"});
+    plain_fee.tx_id = make_tx_id("recheck");
+    plain_fee.inputs.push_back({"recheck", 1, "Carol"});
+    plain_fee.outputs.push_back({9.5, "Bob"});
+    keys.sign_transaction(rich_fee);
+    keys.sign_transaction(plain_fee);
+    bool admitted = mp2.add_transaction(rich_fee, um2).first && mp2.add_transaction(plain_fee, um2).first;
+    KeyStore other;
+    verifier.register_key("Alice", other.ensure("Alice")); //Alice's key changes, her pending spend no longer verifies
+    Block rechecked = mine_block("Miner", mp2, um2, 1, 5.0, 1);
+    bool recheck = admitted && rechecked.transactions.size() == 1 && rechecked.transactions[0].tx_id == plain_fee.tx_id
+        && mp2.transactions.empty() && um2.exists("recheck", 0);
+    expect(recheck, "A transaction failing the mining recheck should be evicted and the next one mined");
+    cout << endl;
+    return r1.first && !r2.first && !r3.first && !r4.first && cached && batch_ok && recheck;
+}
+
+/*
+Test 18: Fee Estimator
+- High fee-rate transactions confirm in the next block, low fee-rate ones wait 4 blocks
+- Expected: 1-block estimate lands in the high range, a 6-block target allows cheaper rates
+- Estimator state survives save/load
+- Files with a spacing of 1, a zero minimum rate or bounds that do not follow from them are
+  rejected and the loaded state is kept
+*/
+static bool test_fee_estimator() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 18: Fee Estimator" << endl;
+    FeeEstimator est;
+    int id = 0;
+    auto make = [&](double fee) {
+        Transaction tx;
+        tx.tx_id = "tx_fee_" + to_string(id++);
+        tx.inputs.push_back({"genesis", 0, "Alice"});
+        tx.outputs.push_back({1.0, "Bob"});
+        tx.fee = fee;
+        return tx;
+    };
+
+    expect(est.estimate_fee_rate(1) < 0, "No estimate without data");
+    int height = 0;
+    for (int round = 0; round < 6; round++) {
+        vector<Transaction> fast, slow;
+        for (int i = 0; i < 5; i++) fast.push_back(make(0.01));
+        for (int i = 0; i < 5; i++) slow.push_back(make(0.0001));
+        for (auto &t : fast) est.process_transaction(t);
+        for (auto &t : slow) est.process_transaction(t);
+        est.process_block(++height, fast);
+        est.process_block(++height, {});
+        est.process_block(++height, {});
+        est.process_block(++height, slow);
+    }
+    Transaction probe = make(0.0);
+    double fast_rate = 0.01 / tx_size(probe), slow_rate = 0.0001 / tx_size(probe);
+    double next_block = est.estimate_fee_rate(1);
+    double six_blocks = est.estimate_fee_rate(6);
+    est.display_estimates();
+    bool ok1 = next_block > slow_rate * 10 && next_block <= fast_rate * 1.01;
+    expect(ok1, "1-block estimate should require the fast fee rate");
+    bool ok6 = six_blocks > 0 && six_blocks < next_block;
+    expect(ok6, "6-block estimate should be cheaper");
+
+    string path = "fee_estimator_test.dat";
+    bool saved = est.save(path);
+    FeeEstimator restored;
+    bool loaded = restored.load(path);
+    bool same = saved && loaded && fabs(restored.estimate_fee_rate(1) - next_block) < 1e-12 && fabs(restored.estimate_fee_rate(6) - six_blocks) < 1e-12;
+    expect(same, "Estimates should survive save and load");
+
+    //line 1 holds min_rate spacing max_target decay buckets, line 2 the first bucket
+    vector<string> lines;
+    {
+        ifstream in(path);
+        for (string line; getline(in, line);) lines.push_back(line);
+    }
+    auto corrupt_rejected = [&](int line, int field, const string& value) {
+        vector<string> edited = lines;
+        istringstream fields(edited[line]);
+        vector<string> tokens;
+        for (string t; fields >> t;) tokens.push_back(t);
+        tokens[field] = value;
+        edited[line].clear();
+        for (const auto& t : tokens) edited[line] += (edited[line].empty() ? "" : " ") + t;
+        ofstream out(path);
+        for (const auto& l : edited) out << l << "\n";
+        out.close();
+        return !restored.load(path) && fabs(restored.estimate_fee_rate(1) - next_block) < 1e-12;
+    };
+    bool validated = corrupt_rejected(1, 1, "1") && corrupt_rejected(1, 0, "0") && corrupt_rejected(2, 0, "0.5");
+    remove(path.c_str());
+    expect(validated, "A file with unusable spacing, minimum rate or bounds should be rejected");
+    cout << endl;
+    return ok1 && ok6 && same && validated;
+}
+
+/*
+Test 19: Mempool Memory Budget
+- Budget fits three transactions; a fourth with a higher fee rate arrives
+- Expected: cheapest evicted, usage within budget, minimum fee rate raised
+- A cheap transaction is then rejected before its signature is verified
+- The minimum fee rate halves every half life of the mempool's clock and decays to zero
+*/
+static bool test_mempool_memory_budget() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 19: Mempool Memory Budget" << endl;
+    UTXOManager um;
+    KeyStore keys;
+    SignatureVerifier verifier;
+    verifier.register_key("Alice", keys.ensure("Alice"));
+    for (int i = 0; i < 6; i++) {
+        um.add_utxo("genesis", i, 10.0, "Alice");
+    }
+    auto make = [&](int i, double fee) {
+        Transaction tx;
+        tx.tx_id = "tx_budget_" + to_string(i);
+        tx.inputs.push_back({"genesis", i, "Alice"});
+        tx.outputs.push_back({10.0 - fee, "Bob"});
+        keys.sign_transaction(tx);
+        return tx;
+    };
+
+    size_t one_tx = tx_memory_usage(make(0, 0.1));
+    Mempool mp(1000, 0.01, one_tx * 3 + one_tx / 2);
+    mp.verifier = &verifier;
+    int64_t now = 1000;
+    mp.clock = [&now]() { return now; };
+    mp.add_transaction(make(0, 0.3), um);
+    mp.add_transaction(make(1, 0.1), um);
+    mp.add_transaction(make(2, 0.2), um);
+    bool fits = mp.transactions.size() == 3 && mp.memory_usage() == one_tx * 3;
+    expect(fits, "Three transactions should fit and be accounted in bytes");
+
+    auto r = mp.add_transaction(make(3, 0.4), um);
+    bool evicted = r.first && mp.transactions.size() == 3 && find_tx_in_mempool(mp, "tx_budget_1") == nullptr
+        && mp.memory_usage() <= mp.max_bytes && !mp.spent_utxos.count({"genesis", 1});
+    expect(evicted, "Lowest fee-rate transaction should be evicted to stay within budget");
+    double floor_rate = mp.min_fee_rate();
+    bool raised = floor_rate > 0.1 / tx_size(make(1, 0.1));
+    expect(raised, "Eviction should raise the minimum fee rate above the evicted rate");
+
+    uint64_t verified_before = verifier.stats().verified;
+    auto cheap = mp.add_transaction(make(4, 0.05), um);
+    bool cheap_reject = !cheap.first && cheap.second.find("below mempool minimum") != string::npos && verifier.stats().verified == verified_before;
+    expect(cheap_reject, "Cheap transaction should be rejected before signature verification");
+
+    now += 600; // one half life on the mempool's clock
+    bool halved = fabs(mp.min_fee_rate() - floor_rate / 2) < floor_rate * 1e-9;
+    now += 600 * 40;
+    bool decayed = halved && mp.min_fee_rate() == 0;
+    expect(decayed, "Minimum fee rate should halve per half life of the mempool clock and decay to zero");
+    cout << endl;
+    return fits && evicted && raised && cheap_reject && decayed;
+}
+
+/*
+Test 20: Mempool Expiry
+- Three transactions enter a mempool with a 60 second expiry, one gets mined
+- Expected: nothing expires early; afterwards the two stale ones are dropped,
+  their UTXOs are released and can be spent again
+*/
+static bool test_mempool_expiry() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 20: Mempool Expiry" << endl;
+    UTXOManager um;
+    Mempool mp(100, 0.01, 0, 60);
+    for (int i = 0; i < 3; i++) {
+        um.add_utxo("genesis", i, 10.0, "Alice");
+        Transaction tx;
+        tx.tx_id = "tx_expiry_" + to_string(i);
+        tx.inputs.push_back({"genesis", i, "Alice"});
+        tx.outputs.push_back({9.0 - i, "Bob"});
+        mp.add_transaction(tx, um);
+    }
+    int64_t start = Mempool::now_seconds();
+    mine_block("Miner", mp, um, 1, 5.0, 1);
+
+    bool early = mp.expire(start + 30) == 0 && mp.transactions.size() == 2;
+    expect(early, "Nothing should expire before the deadline");
+    int expired = mp.expire(start + 61);
+    bool dropped = expired == 2 && mp.transactions.empty() && mp.spent_utxos.empty() && mp.expiry_wheel.size() == 0;
+    expect(dropped, "Stale transactions should expire and release their outpoints");
+
+    Transaction again;
+    again.tx_id = "tx_expiry_again";
+    again.inputs.push_back({"genesis", 0, "Alice"});
+    again.outputs.push_back({9.5, "Charlie"});
+    auto r = mp.add_transaction(again, um);
+    expect(r.first, "Released UTXO should be spendable again");
+    cout << endl;
+    return early && dropped && r.first;
+}
+
+/*
+Test 21: Replace-By-Fee
+- With replace_by_fee on, a higher-fee spend of the same UTXO replaces the first
+- A replacement that does not beat the existing fee is rejected
+- One transaction spending two UTXOs replaces both conflicting spends at once
+*/
+static bool test_replace_by_fee() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 21: Replace-By-Fee" << endl;
+    UTXOManager um;
+    Mempool mp(100);
+    mp.replace_by_fee = true;
+    um.add_utxo("genesis", 0, 50.0, "Alice");
+    um.add_utxo("genesis", 1, 20.0, "Alice");
+    um.add_utxo("genesis", 2, 20.0, "Alice");
+
+    Transaction low;
+    low.tx_id = make_tx_id("rbf_low");
+    low.inputs.push_back({"genesis", 0, "Alice"});
+    low.outputs.push_back({49.0, "Merchant"});
+    mp.add_transaction(low, um);
+
+    Transaction high;
+    high.tx_id = make_tx_id("rbf_high");
+    high.inputs.push_back({"genesis", 0, "Alice"});
+    high.outputs.push_back({45.0, "Alice"});
+    auto r1 = mp.add_transaction(high, um);
+    bool replaced = r1.first && find_tx_in_mempool(mp, low.tx_id) == nullptr && mp.spent_utxos[{"genesis", 0}] == high.tx_id;
+    expect(replaced, "Higher-fee conflicting transaction should replace the original");
+
+    Transaction cheaper;
+    cheaper.tx_id = make_tx_id("rbf_cheaper");
+    cheaper.inputs.push_back({"genesis", 0, "Alice"});
+    cheaper.outputs.push_back({46.0, "Bob"});
+    auto r2 = mp.add_transaction(cheaper, um);
+    bool kept = !r2.first && find_tx_in_mempool(mp, high.tx_id) != nullptr;
+    expect(kept, "Replacement paying less than the existing fee should be rejected");
+
+    Transaction a, b, both;
+    a.tx_id = make_tx_id("rbf_a");
+    a.inputs.push_back({"genesis", 1, "Alice"});
+    a.outputs.push_back({19.0, "Bob"});
+    b.tx_id = make_tx_id("rbf_b");
+    b.inputs.push_back({"genesis", 2, "Alice"});
+    b.outputs.push_back({19.0, "Charlie"});
+    mp.add_transaction(a, um);
+    mp.add_transaction(b, um);
+    both.tx_id = make_tx_id("rbf_both");
+    both.inputs.push_back({"genesis", 1, "Alice"});
+    both.inputs.push_back({"genesis", 2, "Alice"});
+    both.outputs.push_back({37.0, "David"});
+    auto r3 = mp.add_transaction(both, um);
+    bool multi = r3.first && mp.transactions.size() == 2 && find_tx_in_mempool(mp, a.tx_id) == nullptr
+        && find_tx_in_mempool(mp, b.tx_id) == nullptr && mp.spent_utxos.size() == 3;
+    expect(multi, "Transaction conflicting with two others should replace both");
+    cout << endl;
+    return replaced && kept && multi;
+}
+
+/*
+Test 22: Compact Block Reconstruction
+- Transactions the peer is not known to have are prefilled, the rest become short ids
+- The receiver rebuilds the block from its mempool and reports what it lacks
+- Supplying the missing transactions completes the block in original order
+- A wrong mempool match fails the Merkle root check and is requested in full instead
+  (that receiver's mempool uses the fee-rate selection policy)
+*/
+static bool test_compact_block() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 22: Compact Block Reconstruction" << endl;
+    UTXOManager um;
+    Mempool sender(100), receiver(100);
+    Block block = {1, "Miner", {}, 0, 6.25, "Thu Jan  1 00:00:00 2026"};
+    unordered_set<string> peer_has;
+    for (int i = 0; i < 6; ++i) {
+        string owner = "Owner" + to_string(i);
+        um.add_utxo("genesis", i, 10.0, owner);
+        Transaction tx;
+        tx.tx_id = make_tx_id("cmpct");
+        tx.inputs.push_back({"genesis", i, owner});
+        tx.outputs.push_back({9.0, "Shop"});
+        sender.add_transaction(tx, um);
+        tx.fee = 1.0;
+        block.transactions.push_back(tx);
+        block.total_fees += tx.fee;
+        if (i != 0)
+            peer_has.insert(tx.tx_id); // tx 0 was never relayed
+        if (i != 0 && i != 3)
+            receiver.add_transaction(tx, um); // tx 3 was relayed but the receiver dropped it
+    }
+
+    CompactBlock cb = make_compact_block(block, peer_has, 42);
+    bool encoded = cb.prefilled.size() == 1 && cb.prefilled[0].first == 0 && cb.short_ids.size() == 5
+        && compact_block_size(cb) < block_size(block);
+    expect(encoded, "Only the unrelayed transaction should be sent in full");
+
+    CompactReconstruction r = reconstruct_block(cb, receiver);
+    bool reports_missing = r.missing.size() == 1 && r.missing[0] == 3;
+    expect(reports_missing, "Reconstruction should report the one transaction absent from the mempool");
+
+    bool completed = fill_missing(r, cb, {block.transactions[3]}) && r.complete();
+    for (size_t i = 0; completed && i < block.transactions.size(); ++i)
+        completed = r.block.transactions[i].tx_id == block.transactions[i].tx_id;
+    completed = completed && fabs(r.block.total_fees - block.total_fees) < EPS
+        && r.block.merkle_root == compute_merkle_root(block.transactions);
+    expect(completed, "Filling the missing transaction should rebuild the original block");
+
+    //the receiver holds a different transaction under the short id of position 2, as a
+    //collision would give it; every short id matches but the Merkle root does not
+    BasicMempool<SelectByFeeRate> stale(100);
+    for (size_t i = 1; i < block.transactions.size(); ++i) {
+        Transaction tx = block.transactions[i];
+        if (i == 2) tx.outputs[0].address = "Thief";
+        stale.add_transaction(tx, um);
+    }
+    CompactReconstruction s = reconstruct_block(cb, stale);
+    bool refetched = !s.complete() && s.missing == vector<int>({1, 2, 3, 4, 5});
+    vector<Transaction> reply;
+    for (int pos : s.missing) reply.push_back(block.transactions[pos]);
+    refetched = refetched && fill_missing(s, cb, reply) && s.complete()
+        && s.block.transactions[2].outputs[0].address == "Shop";
+    expect(refetched, "A mismatched Merkle root should fall back to requesting the matched transactions");
+    cout << endl;
+    return encoded && reports_missing && completed && refetched;
+}
+
+/*
+Test 23: Disk-Backed UTXO Store with Write-Back Cache
+- Changes reach the store only when the cache is flushed at a block boundary
+- Outputs created and spent between flushes are never written
+- A block with a missing input leaves the view unchanged
+- The store survives close and reopen; lookups then miss once and hit afterwards
+*/
+static bool test_utxo_disk_cache() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 23: Disk-Backed UTXO Store with Write-Back Cache" << endl;
+    const string path = "utxo_store_test";
+    bool batched = false, fresh_skipped = false, rolled_back = false, persisted = false;
+    {
+        UTXODiskStore store;
+        store.open(path, 16);
+        UTXOCache cache(store, 8);
+        cache.add_utxo("genesis", 0, 50.0, "Alice");
+        cache.add_utxo("genesis", 1, 30.0, "Bob");
+        batched = store.size() == 0 && cache.dirty() == 2;
+        cache.flush();
+        batched = batched && store.size() == 2 && cache.dirty() == 0;
+        expect(batched, "UTXOs should reach the store only on flush");
+
+        Block block = {1, "Miner", {}, 0.5, 6.25, ""};
+        Transaction pay, spend_change;
+        pay.tx_id = make_tx_id("disk_pay");
+        pay.inputs.push_back({"genesis", 0, "Alice"});
+        pay.outputs.push_back({20.0, "Charlie"});
+        pay.outputs.push_back({29.5, "Alice"});
+        spend_change.tx_id = make_tx_id("disk_change");
+        spend_change.inputs.push_back({pay.tx_id, 1, "Alice"});
+        spend_change.outputs.push_back({29.5, "David"});
+        block.transactions = {pay, spend_change};
+        uint64_t writes_before = store.writes;
+        auto result = connect_block(block, cache);
+        UTXOCacheStats st = cache.stats();
+        // Charlie's and David's outputs plus the coinbase are written; Alice's change never is
+        fresh_skipped = result.first && st.fresh_spends == 1 && store.writes - writes_before == 3
+            && !cache.exists("genesis", 0) && store.size() == 4;
+        expect(fresh_skipped, "An output created and spent in one block should never touch disk");
+
+        Block bad = {2, "Miner", {}, 0, 6.25, ""};
+        Transaction ok_tx, missing;
+        ok_tx.tx_id = make_tx_id("disk_ok");
+        ok_tx.inputs.push_back({"genesis", 1, "Bob"});
+        ok_tx.outputs.push_back({30.0, "Eve"});
+        missing.tx_id = make_tx_id("disk_missing");
+        missing.inputs.push_back({"nowhere", 0, "Bob"});
+        missing.outputs.push_back({1.0, "Eve"});
+        bad.transactions = {ok_tx, missing};
+        auto bad_result = connect_block(bad, cache);
+        rolled_back = !bad_result.first && cache.exists("genesis", 1) && !cache.exists(ok_tx.tx_id, 0)
+            && cache.dirty() == 0 && cache.stats().fresh_spends == st.fresh_spends;
+        expect(rolled_back, "A block with a missing input should leave the view unchanged");
+    }
+    {
+        UTXODiskStore store;
+        store.open(path);
+        UTXOCache cache(store, 8);
+        UTXO u;
+        bool found = cache.get_utxo("genesis", 1, u) && u.owner == "Bob" && fabs(u.amount - 30.0) < EPS;
+        found = found && cache.exists("genesis", 1) && !cache.exists("genesis", 0);
+        UTXOCacheStats st = cache.stats();
+        persisted = found && store.size() == 4 && st.misses == 2 && st.hits == 1;
+        expect(persisted, "The store should reopen with the flushed UTXO set");
+    }
+    remove((path + ".idx").c_str());
+    remove((path + ".dat").c_str());
+    cout << endl;
+    return batched && fresh_skipped && rolled_back && persisted;
+}
+
+/*
+Test 24: UTXO Set Hash
+- Sets built in different orders, or reached by adding and removing, hash equal
+- Changing one amount changes the hash
+- A mined block records the hash; replaying it on the prior state reproduces it
+- connect_block rejects a block whose recorded hash does not match
+*/
+static bool test_utxo_set_hash() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 24: UTXO Set Hash" << endl;
+    UTXOManager a, b;
+    a.add_utxo("genesis", 0, 50.0, "Alice");
+    a.add_utxo("genesis", 1, 30.0, "Bob");
+    a.add_utxo("genesis", 2, 20.0, "Charlie");
+    b.add_utxo("genesis", 2, 20.0, "Charlie");
+    b.add_utxo("temp", 0, 1.0, "Eve");
+    b.add_utxo("genesis", 0, 50.0, "Alice");
+    b.add_utxo("genesis", 1, 99.0, "Bob");
+    b.add_utxo("genesis", 1, 30.0, "Bob"); // overwrite
+    b.remove_utxo("temp", 0);
+    bool order_free = a.state_hash() == b.state_hash();
+    expect(order_free, "Equal UTXO sets should have equal hashes regardless of history");
+
+    b.add_utxo("genesis", 2, 20.5, "Charlie");
+    bool sensitive = a.state_hash() != b.state_hash();
+    expect(sensitive, "Changing an amount should change the hash");
+
+    UTXOManager before = a;
+    Mempool mp(10);
+    Transaction tx;
+    tx.tx_id = make_tx_id("sethash");
+    tx.inputs.push_back({"genesis", 0, "Alice"});
+    tx.outputs.push_back({49.0, "David"});
+    mp.add_transaction(tx, a);
+    Block block = mine_block("Miner", mp, a, 1, 6.25);
+    UTXOManager replay = before;
+    BlockUndo undo;
+    bool recorded = block.has_utxo_hash() && block.utxo_hash == a.state_hash()
+        && connect_block(block, replay, undo).first && replay.state_hash() == a.state_hash();
+    expect(recorded, "Replaying a mined block should reproduce its recorded hash");
+
+    Block forged = block;
+    forged.transactions[0].outputs[0].address = "Mallory";
+    UTXOManager target = before;
+    bool rejected = !connect_block(forged, target, undo).first && target.state_hash() == before.state_hash();
+    expect(rejected, "A block whose result does not match its recorded hash should be rejected");
+    cout << endl;
+    return order_free && sensitive && recorded && rejected;
+}
+
+/*
+Test 25: Parallel Block Connection
+- Independent transactions form separate groups, a chain stays in one group
+- Connecting on several threads gives the same UTXO set as serial connect_block
+- An invalid block fails with the serial error and leaves the set unchanged: a chain out of
+  order, a tampered Merkle root, a pruned block, and unsigned inputs under a verifier
+*/
+static bool test_parallel_connect() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 25: Parallel Block Connection" << endl;
+    UTXOManager base;
+    Block block = {1, "Miner", {}, 0, 6.25, ""};
+    for (int i = 0; i < 8; ++i) {
+        base.add_utxo("genesis", i, 10.0, "Owner" + to_string(i));
+        Transaction tx;
+        tx.tx_id = make_tx_id("par");
+        tx.inputs.push_back({"genesis", i, "Owner" + to_string(i)});
+        tx.outputs.push_back({9.0, "Shop"});
+        tx.fee = 1.0;
+        block.transactions.push_back(tx);
+        block.total_fees += tx.fee;
+    }
+    // chain: genesis:8 -> c1 -> c2 -> c3, like an unconfirmed chain mined in one block
+    base.add_utxo("genesis", 8, 10.0, "Alice");
+    string prev = "genesis";
+    int prev_index = 8;
+    for (int i = 0; i < 3; ++i) {
+        Transaction tx;
+        tx.tx_id = make_tx_id("chain");
+        tx.inputs.push_back({prev, prev_index, "Alice"});
+        tx.outputs.push_back({9.0 - i, "Alice"});
+        tx.fee = 1.0;
+        block.transactions.push_back(tx);
+        block.total_fees += tx.fee;
+        prev = tx.tx_id;
+        prev_index = 0;
+    }
+
+    vector<vector<int>> groups = block_dependency_groups(block);
+    bool grouped = groups.size() == 9 && groups.back() == vector<int>({8, 9, 10});
+    expect(grouped, "Chained transactions should share a group, independent ones should not");
+
+    UTXOManager serial = base;
+    BlockUndo undo;
+    connect_block(block, serial, undo);
+    ConcurrentUTXOSet shared(base, 8);
+    ParallelConnectStats stats;
+    auto result = parallel_connect_block(block, shared, 4, &stats);
+    bool identical = result.first && shared.state_hash() == serial.state_hash()
+        && shared.to_manager().utxo_set.size() == serial.utxo_set.size() && stats.threads == 4;
+    for (const auto& u : serial.utxo_set) {
+        UTXO got;
+        identical = identical && shared.take_utxo(u.first.first, u.first.second, got)
+            && got.owner == u.second.owner && fabs(got.amount - u.second.amount) < EPS;
+    }
+    expect(identical, "Parallel connection should produce the same UTXO set as serial");
+
+    Block bad = block;
+    swap(bad.transactions[9], bad.transactions[10]); // c2 now precedes the tx creating its input
+    UTXOManager serial_bad = base;
+    auto serial_result = connect_block(bad, serial_bad, undo);
+    ConcurrentUTXOSet shared_bad(base, 8);
+    auto parallel_result = parallel_connect_block(bad, shared_bad, 4);
+    bool same_failure = !parallel_result.first && parallel_result.second == serial_result.second
+        && shared_bad.state_hash() == base.state_hash();
+    expect(same_failure, "An out-of-order chain should fail like serial connection and roll back");
+
+    Block tampered = block;
+    tampered.merkle_root = compute_merkle_root(block.transactions);
+    tampered.transactions[0].outputs[0].amount = 9.5; // keeps its inputs, so only the root tells
+    Block pruned = block;
+    pruned.prune();
+    SignatureVerifier no_keys;
+    bool both_reject = true;
+    for (int c = 0; c < 3; ++c) {
+        const Block& b = c == 0 ? tampered : c == 1 ? pruned : block;
+        SignatureVerifier* verifier = c == 2 ? &no_keys : nullptr;
+        UTXOManager s = base;
+        BlockUndo u;
+        auto sr = connect_block(b, s, u, verifier);
+        ConcurrentUTXOSet p(base, 8);
+        auto pr = parallel_connect_block(b, p, 4, nullptr, verifier);
+        both_reject = both_reject && !sr.first && !pr.first && sr.second == pr.second
+            && s.state_hash() == base.state_hash() && p.state_hash() == base.state_hash();
+    }
+    expect(both_reject, "Tampered Merkle root, pruned and unsigned blocks should fail alike on both paths");
+    cout << endl;
+    return grouped && identical && same_failure && both_reject;
+}
+
+/*
+Test 26: Block Pruning
+- Blocks deeper than the prune depth drop their bodies but keep a summary
+- The summary keeps tx count, Merkle root, integer time and still displays
+- Reorganizing below the pruned part of the chain is refused
+*/
+static bool test_block_pruning() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 26: Block Pruning" << endl;
+    UTXOManager um;
+    Mempool mp(10);
+    vector<Block> chain;
+    vector<BlockUndo> undo_log;
+    for (int h = 1; h <= 3; ++h) {
+        for (int i = 0; i < 2; ++i) {
+            um.add_utxo("prune_src", 2 * h + i, 10.0, "Alice");
+            Transaction tx;
+            tx.tx_id = make_tx_id("prune");
+            tx.inputs.push_back({"prune_src", 2 * h + i, "Alice"});
+            tx.outputs.push_back({9.0, "Bob"});
+            mp.add_transaction(tx, um);
+        }
+        BlockUndo undo;
+        chain.push_back(mine_block("Miner", mp, um, h, 6.25, 4, &undo));
+        undo_log.push_back(undo);
+    }
+    int full_count = chain[0].num_transactions();
+    crypto::SetHash root = compute_merkle_root(chain[0].transactions);
+
+    int last_pruned = 0;
+    int pruned = prune_chain(chain, undo_log, 2, &last_pruned);
+    bool summarized = pruned == 1 && last_pruned == 1 && prune_chain(chain, undo_log, 2, &last_pruned) == 0 && chain[0].pruned && chain[0].transactions.empty() && chain[0].timestamp.empty()
+        && chain[0].num_transactions() == full_count && chain[0].merkle_root == root && chain[0].time > 0
+        && !chain[1].pruned && undo_log[0].spent.empty() && undo_log[0].created.empty();
+    expect(summarized, "Blocks below the prune depth should keep only their summary");
+
+    bool displays = chain[0].display() > 0 && chain[1].display() > 0;
+    expect(displays, "Pruned and full blocks should both display");
+
+    crypto::SetHash before = um.state_hash();
+    auto deep = reorganize_chain(chain, undo_log, 0, vector<Block>(4, chain[1]), um, mp);
+    bool refused = !deep.first && deep.second.find("pruned") != string::npos && chain.size() == 3 && um.state_hash() == before;
+    expect(refused, "Reorganizing below the pruned height should be refused");
+    cout << endl;
+    return summarized && displays && refused;
+}
+
+/*
+Test 27: Allocation-Free Lookups
+- exists() and get_balance() with views, literals and strings allocate nothing, on the
+  ordered and the hashed storage (counted only in builds with -DSIM_COUNT_ALLOCATIONS)
+- Transactions moved into the mempool and mined into a block keep their data
+*/
+static bool test_allocation_free_lookups() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 27: Allocation-Free Lookups" << endl;
+    UTXOManager um;
+    BasicUTXOManager<HashedUTXOMap> hashed;
+    const string long_id = "genesis_transaction_with_an_id_longer_than_small_string_storage";
+    const string owner = "an_owner_name_that_does_not_fit_in_small_string_storage";
+    for (int i = 0; i < 50; ++i) {
+        um.add_utxo(long_id, i, 1.0, i % 2 ? owner : "Bob");
+        hashed.add_utxo(long_id, i, 1.0, i % 2 ? owner : "Bob");
+    }
+    hashed.exists(long_id, 0); // C++17 builds size the reused lookup key once
+
+    size_t before = heap_allocations.load();
+    bool found = true;
+    double balance = 0;
+    for (int i = 0; i < 100; ++i) {
+        found = found && um.exists(long_id, i % 50) && !um.exists("missing_tx_id_that_is_also_quite_long_indeed", 0)
+            && hashed.exists(long_id, i % 50) && !hashed.exists("missing_tx_id_that_is_also_quite_long", 0);
+        balance += um.get_balance(owner) + um.get_balance("Bob");
+    }
+    size_t allocations = heap_allocations.load() - before;
+    bool zero = found && fabs(balance - 100 * 50.0) < 1e-6;
+    expect(zero, "exists/get_balance should find every UTXO and balance");
+    if (counting_allocations) {
+        zero = zero && allocations == 0;
+        expect(allocations == 0, "exists/get_balance should not allocate (" + to_string(allocations) + " allocations)");
+    }
+    else
+        skip("exists/get_balance allocation count: build with -DSIM_COUNT_ALLOCATIONS to check it");
+
+    Mempool mp(10);
+    Transaction tx;
+    tx.tx_id = make_tx_id("moved");
+    tx.inputs.push_back({long_id, 1, owner, string(64, 's')});
+    tx.outputs.push_back({0.5, "Carol"});
+    auto r = mp.add_transaction(move(tx), um);
+    Block block = mine_block("Miner", mp, um, 1, 6.25);
+    bool moved = r.first && mp.transactions.empty() && block.transactions.size() == 1
+        && block.transactions[0].inputs[0].signature.size() == 64 && um.exists(block.transactions[0].tx_id, 0);
+    expect(moved, "A transaction moved through the mempool into a block should keep its data");
+    cout << endl;
+    return zero && moved;
+}
+
+/*
+Test 28: JSON-RPC Server
+- JSON documents survive a parse/dump round trip and malformed ones are rejected
+- A batch sent over a Unix socket is answered in order under one lock acquisition
+- Notifications get no response, unknown methods and handler failures get errors
+- A line longer than MAX_LINE is rejected and its connection closed
+- A client that does not read its replies stops being read once MAX_PENDING_OUTPUT is
+  queued, and still gets every reply in order when it reads them
+- count, limit, offset, from and to that are not non-negative integers get -32602
+(the simulator type is a template parameter because this file is included before it is defined)
+*/
+template<typename Sim>
+static bool test_rpc_server() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 28: JSON-RPC Server" << endl;
+    Json doc;
+    string error;
+    const string text = "{\"a\":[1,2.5,-3e2,true,null],\"b\":\"q\\\"\\u00e9\\n\"}";
+    bool parsed = Json::parse(text, doc, error) && doc.dump() == "{\"a\":[1,2.5,-300,true,null],\"b\":\"q\\\"\xc3\xa9\\n\"}"
+        && !Json::parse("{\"a\":1", doc, error) && !Json::parse("[1,]", doc, error);
+    expect(parsed, "JSON should round trip and malformed input should be rejected");
+
+    RpcServer server;
+    double total = 0;
+    server.register_method("add", [&](const Json& params, Json& result) -> pair<bool, string> {
+        const Json* v = params.get("value");
+        if (!v || !v->is_number())
+            return {false, "value required"};
+        total += v->number;
+        result = Json(total);
+        return {true, ""};
+    });
+    const string chunk(64 * 1024, 'z');
+    server.register_method("big", [&](const Json&, Json& result) -> pair<bool, string> {
+        result = Json(chunk);
+        return {true, ""};
+    });
+    string path = "/tmp/sim_rpc_test_" + to_string(getpid()) + ".sock";
+    bool listening = server.listen_unix(path).first;
+    thread loop([&]() { server.run(); });
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    bool connected = listening && connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    auto call = [&](const string& line) {
+        string request = line + "\n", reply;
+        if (!connected || send(fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size())
+            return reply;
+        char c;
+        while (recv(fd, &c, 1, 0) == 1 && c != '\n')
+            reply += c;
+        return reply;
+    };
+
+    string batch = call("[{\"jsonrpc\":\"2.0\",\"method\":\"add\",\"params\":{\"value\":2},\"id\":1},"
+                        "{\"jsonrpc\":\"2.0\",\"method\":\"add\",\"params\":{\"value\":3}},"
+                        "{\"jsonrpc\":\"2.0\",\"method\":\"add\",\"params\":{\"value\":5},\"id\":\"x\"},"
+                        "{\"jsonrpc\":\"2.0\",\"method\":\"nope\",\"id\":3},"
+                        "{\"jsonrpc\":\"2.0\",\"method\":\"add\",\"params\":{},\"id\":4}]");
+    size_t locks, batches;
+    {
+        lock_guard<mutex> guard(server.state_mutex);
+        locks = server.lock_acquisitions;
+        batches = server.batches;
+    }
+    bool batched = batch == "[{\"jsonrpc\":\"2.0\",\"result\":2,\"id\":1},"
+                            "{\"jsonrpc\":\"2.0\",\"result\":10,\"id\":\"x\"},"
+                            "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32601,\"message\":\"Method not found: nope\"},\"id\":3},"
+                            "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32000,\"message\":\"value required\"},\"id\":4}]"
+        && locks == 1 && batches == 1;
+    expect(batched, "Batch should be answered in order under one lock");
+
+    string bad = call("{oops");
+    string single = call("{\"jsonrpc\":\"2.0\",\"method\":\"add\",\"params\":{\"value\":1},\"id\":7}");
+    bool errors = bad.find("-32700") != string::npos && single == "{\"jsonrpc\":\"2.0\",\"result\":11,\"id\":7}";
+    expect(errors, "Parse errors should be reported and the connection kept open");
+    close(fd);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    connected = listening && connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    string oversized = call(string(RpcServer::MAX_LINE + 1, 'x'));
+    char c;
+    bool limited = oversized.find("Request too large") != string::npos && recv(fd, &c, 1, 0) <= 0;
+    expect(limited, "A line over MAX_LINE should be rejected and the connection closed");
+    close(fd);
+
+    //asks for 200 large replies without reading any, then reads them all
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    connected = listening && connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    const int asked = 200;
+    size_t before;
+    {
+        lock_guard<mutex> guard(server.state_mutex);
+        before = server.requests;
+    }
+    string requests;
+    for (int i = 0; i < asked; ++i)
+        requests += "{\"jsonrpc\":\"2.0\",\"method\":\"big\",\"id\":" + to_string(i) + "}\n";
+    bool sent = connected && send(fd, requests.data(), requests.size(), MSG_NOSIGNAL) == (ssize_t)requests.size();
+    this_thread::sleep_for(chrono::milliseconds(200));
+    size_t answered_unread;
+    {
+        lock_guard<mutex> guard(server.state_mutex);
+        answered_unread = server.requests - before;
+    }
+    int replies = 0;
+    bool in_order = true;
+    string pending;
+    char buf[65536];
+    while (sent && replies < asked) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            break;
+        pending.append(buf, n);
+        size_t start = 0;
+        for (size_t nl = pending.find('\n'); nl != string::npos; nl = pending.find('\n', start)) {
+            string id = "\"id\":" + to_string(replies) + "}";
+            in_order = in_order && nl - start > id.size() && pending.compare(nl - id.size(), id.size(), id) == 0;
+            replies++;
+            start = nl + 1;
+        }
+        pending.erase(0, start);
+    }
+    close(fd);
+    bool backpressure = sent && answered_unread < (size_t)asked && replies == asked && in_order;
+    expect(backpressure, "A client not reading its replies should stop being read (" + to_string(answered_unread)
+        + " of " + to_string(asked) + " answered) and then get every reply");
+    server.stop();
+    loop.join();
+
+    Sim sim(0.01, 6.25, 5, 2, 1 << 20, 3600, 28);
+    RpcServer methods;
+    sim.register_rpc_methods(methods);
+    auto code = [&](const string& method, const string& params) {
+        Json doc;
+        string parse_error;
+        string reply = methods.handle_line("{\"jsonrpc\":\"2.0\",\"method\":\"" + method + "\",\"params\":" + params + ",\"id\":1}");
+        if (!Json::parse(reply, doc, parse_error))
+            return 1;
+        const Json* err = doc.get("error");
+        return err && err->get("code") ? (int)err->get("code")->number : 0;
+    };
+    bool checked = code("get_rich_list", "{\"count\":2.5}") == RpcServer::INVALID_PARAMS
+        && code("get_rich_list", "{\"count\":-1}") == RpcServer::INVALID_PARAMS
+        && code("get_rich_list", "{\"count\":1e300}") == RpcServer::INVALID_PARAMS
+        && code("list_utxos", "{\"limit\":\"3\"}") == RpcServer::INVALID_PARAMS
+        && code("list_utxos", "{\"offset\":-2}") == RpcServer::INVALID_PARAMS
+        && code("get_blocks", "{\"from\":1e300}") == RpcServer::INVALID_PARAMS
+        && code("get_blocks", "{\"to\":-1}") == RpcServer::INVALID_PARAMS
+        && code("get_rich_list", "{\"count\":1}") == 0 && code("list_utxos", "{\"offset\":0,\"limit\":2}") == 0
+        && code("get_blocks", "{\"from\":1,\"to\":3}") == 0;
+    expect(checked, "Counts, offsets and heights that are not non-negative integers should get -32602");
+    cout << endl;
+    return parsed && batched && errors && limited && backpressure && checked;
+}
+
+/*
+Test 29: Event Log Record and Replay
+- Two simulators with the same seed produce the same transaction ids and state
+- A recorded run replays to the same UTXO/mempool state hash
+- Truncated logs and logs with a wrong final hash are rejected
+(the simulator type is a template parameter because this file is included before it is defined)
+*/
+template<typename Sim>
+static bool test_event_log_replay() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 29: Event Log Record and Replay" << endl;
+    string path = "/tmp/sim_events_" + to_string(getpid()) + ".log";
+    Sim recorded(0.01, 6.25, 5, 2, 1 << 20, 3600, 42), twin(0.01, 6.25, 5, 2, 1 << 20, 3600, 42);
+    bool opened = recorded.start_recording(path).first;
+    string first_id, twin_id;
+    auto workload = [](Sim& sim, string& id) {
+        sim.create_transaction("Alice", "Bob", 10, &id);
+        sim.create_transaction("Bob", "Charlie", 5);
+        sim.create_transaction("Zed", "Bob", 1); //rejected, still logged
+        sim.mine_next_block("Miner1");
+        sim.create_transaction("Charlie", "David", 12);
+        sim.create_transaction("Miner1", "Eve", 3);
+    };
+    workload(recorded, first_id);
+    workload(twin, twin_id);
+    recorded.stop_recording();
+    bool seeded = first_id == twin_id && recorded.state_hash() == twin.state_hash();
+    expect(seeded, "Same seed should give the same transaction ids and state");
+
+    ReplayStats stats = {};
+    auto replayed = Sim::replay(path, &stats);
+    bool matches = opened && replayed.first && stats.events == 8 && stats.state_hash == recorded.state_hash();
+    expect(matches, "Replay should reproduce the recorded state: " + replayed.second);
+
+    string bytes;
+    {
+        ifstream in(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    auto write_log = [&](const string& data) {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << data;
+    };
+    write_log(bytes.substr(0, bytes.size() - 40));
+    bool truncated = !Sim::replay(path).first;
+    string tampered = bytes;
+    tampered.back() ^= 1;
+    write_log(tampered);
+    bool mismatch = !Sim::replay(path).first;
+    remove(path.c_str());
+    expect(truncated && mismatch, "Truncated or tampered logs should fail to replay");
+    cout << endl;
+    return seeded && matches && truncated && mismatch;
+}
+
+/*
+Test 31: Compile-Time Policies
+- SelectByFeeRate mines small high-rate transactions before large high-fee ones
+- FlatFee makes the mempool reject transactions paying less than the flat fee
+- HashedUTXOMap holds the same set, with the same state hash, as the ordered default
+- Halving schedules with a fixed interval are evaluated at compile time
+*/
+static bool test_policies() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 31: Compile-Time Policies" << endl;
+    UTXOManager ordered;
+    BasicUTXOManager<HashedUTXOMap> hashed;
+    for (int i = 0; i < 3; ++i) {
+        ordered.add_utxo("policy_src", i, 10.0, "Alice");
+        hashed.add_utxo("policy_src", i, 10.0, "Alice");
+    }
+    auto make = [](int index, double fee, int extra_outputs) {
+        Transaction tx;
+        tx.tx_id = make_tx_id("policy");
+        tx.inputs.push_back({"policy_src", index, "Alice"});
+        tx.outputs.push_back({10.0 - fee, "Bob"});
+        for (int i = 0; i < extra_outputs; ++i) tx.outputs.push_back({0, "Padding" + to_string(i)});
+        return tx;
+    };
+    Transaction big = make(0, 0.3, 40), small = make(1, 0.2, 0);
+    BasicMempool<SelectByFee> by_fee(10);
+    BasicMempool<SelectByFeeRate> by_rate(10);
+    bool admitted = by_fee.add_transaction(big, ordered).first && by_fee.add_transaction(small, ordered).first
+        && by_rate.add_transaction(big, hashed).first && by_rate.add_transaction(small, hashed).first;
+    Block fee_block = mine_block("Miner", by_fee, ordered, 1, 6.25, 1);
+    Block rate_block = mine_block("Miner", by_rate, hashed, 1, 6.25, 1);
+    bool selection = admitted && fee_block.transactions[0].tx_id == big.tx_id && rate_block.transactions[0].tx_id == small.tx_id;
+    expect(selection, "Fee selection should mine the large tx first, fee rate selection the small one");
+
+    BasicMempool<SelectByFee, FlatFee> flat(10, 0.05);
+    bool flat_fee = !flat.add_transaction(make(2, 0.01, 0), ordered).first && flat.add_transaction(make(2, 0.05, 0), ordered).first;
+    expect(flat_fee, "FlatFee should reject fees below the flat fee");
+
+    UTXOManager a;
+    BasicUTXOManager<HashedUTXOMap> b;
+    for (int i = 0; i < 100; ++i) {
+        a.add_utxo("h" + to_string(i), i % 3, i, "Owner" + to_string(i % 7));
+        b.add_utxo("h" + to_string(99 - i), (99 - i) % 3, 99 - i, "Owner" + to_string((99 - i) % 7));
+    }
+    for (int i = 0; i < 100; i += 3) {
+        a.remove_utxo("h" + to_string(i), i % 3);
+        b.remove_utxo("h" + to_string(i), i % 3);
+    }
+    bool storage = a.state_hash() == b.state_hash() && a.utxo_set.size() == b.utxo_set.size()
+        && fabs(a.get_balance("Owner3") - b.get_balance("Owner3")) < EPS && b.exists("h1", 1) && !b.exists("h0", 0);
+    expect(storage, "Hashed storage should match the ordered set and its hash");
+
+    static_assert(HalveEvery<3>::halves(6, 0) && !HalveEvery<3>::halves(7, 0) && !NeverHalve::halves(4, 0), "constexpr halving");
+    bool halving = HalveEveryK::halves(4, 2) && !HalveEveryK::halves(3, 2);
+    expect(halving, "Halving policies should follow their schedules");
+    cout << endl;
+    return selection && flat_fee && storage && halving;
+}
+
+/*
+Test 32: Rich List and Supply
+- Top-K holders, ranks and total supply match a full scan after random adds and removes
+- An owner whose last UTXO is spent leaves the ranking
+- Block rewards follow the halving schedule, failed mining attempts do not halve, and
+  the supply equals genesis plus the rewards issued
+*/
+template<typename Sim>
+static bool test_rich_list_supply() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 32: Rich List and Supply" << endl;
+    UTXOManager um;
+    mt19937 rng(32);
+    vector<pair<string, int>> live;
+    for (int i = 0; i < 3000; ++i) {
+        if (live.empty() || rng() % 3) {
+            string id = "rich_" + to_string(i);
+            um.add_utxo(id, 0, (rng() % 10000) / 100.0, "Owner" + to_string(rng() % 50));
+            live.push_back({id, 0});
+        } else {
+            size_t pick = rng() % live.size();
+            um.remove_utxo(live[pick].first, live[pick].second);
+            live[pick] = live.back();
+            live.pop_back();
+        }
+    }
+    map<string, double> scanned;
+    double scanned_supply = 0;
+    for (const auto& u : um.utxo_set) {
+        scanned[u.second.owner] += u.second.amount;
+        scanned_supply += u.second.amount;
+    }
+    vector<pair<double, string>> expected_order;
+    for (const auto& b : scanned) expected_order.push_back({-b.second, b.first});
+    sort(expected_order.begin(), expected_order.end());
+    auto top = um.rich_list.top(10);
+    bool ranking = top.size() == 10 && um.rich_list.num_holders() == scanned.size()
+        && fabs(um.rich_list.total_supply() - scanned_supply) < 1e-6;
+    for (size_t i = 0; ranking && i < top.size(); ++i)
+        ranking = top[i].first == expected_order[i].second && fabs(top[i].second + expected_order[i].first) < 1e-6
+            && um.rich_list.rank(top[i].first) == i + 1;
+    expect(ranking, "Top holders, ranks and supply should match a full scan");
+
+    UTXOManager small;
+    small.add_utxo("r", 0, 5.0, "Solo");
+    small.add_utxo("r", 1, 7.0, "Pair");
+    small.remove_utxo("r", 0);
+    bool dropped = small.rich_list.rank("Solo") == 0 && small.rich_list.rank("Pair") == 1 && small.rich_list.num_holders() == 1
+        && fabs(small.rich_list.total_supply() - 7.0) < EPS;
+    expect(dropped, "An owner without UTXOs should leave the ranking");
+
+    Sim sim(0.01, 6.25, 5, 2, 1 << 20, 3600, 32);
+    const char* senders[] = {"Alice", "Bob", "Charlie", "Miner", "Alice"};
+    bool empty_attempt = sim.mine_next_block("Miner").block_height == -1;
+    for (const char* sender : senders) {
+        sim.create_transaction(sender, "David", 1.0);
+        sim.mine_next_block("Miner");
+    }
+    auto audit = sim.audit_supply();
+    double expected_supply = 115 + 6.25 + 6.25 + 3.125 + 3.125 + 1.5625;
+    bool supply = empty_attempt && audit.first && fabs(sim.rich_list().total_supply() - expected_supply) < 1e-6;
+    expect(supply, "Supply should follow the halving schedule: " + audit.second);
+    cout << endl;
+    return ranking && dropped && supply;
+}
+
+/*
+Test 33: Paginated Views
+- The text view of a height range matches what Block::display() printed, arrows included
+- JSON lines carry the same data as block_to_json() and utxo_to_json()
+- Height range, owner filter, offset and limit select the right page and report more
+- Output leaves in one write per 64 KB, and a small threshold splits it without changing it
+*/
+static bool test_paginated_views() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 33: Paginated Views" << endl;
+    UTXOManager um;
+    Mempool mp(100);
+    vector<Block> chain;
+    streambuf* saved = cout.rdbuf(nullptr);
+    for (int h = 1; h <= 12; ++h) {
+        um.add_utxo("view_src", h, 10.0, h % 2 ? "Alice" : "Bob");
+        Transaction tx;
+        tx.tx_id = make_tx_id("view");
+        tx.inputs.push_back({"view_src", h, h % 2 ? "Alice" : "Bob"});
+        tx.outputs.push_back({9.5, "Carol"});
+        mp.add_transaction(tx, um);
+        chain.push_back(mine_block("Miner" + to_string(h), mp, um, h, 6.25, 4));
+    }
+    chain[0].prune();
+    ostringstream old_text;
+    cout.rdbuf(old_text.rdbuf());
+    for (int i = 0; i < 4; ++i) {
+        int box_width = chain[i].display();
+        if (i < 3) {
+            int center_pos = box_width / 2 - 3;
+            cout << endl;
+            cout << "  " << string(center_pos - 1, ' ') << "|" << endl;
+            cout << "  " << string(center_pos - 1, ' ') << "v" << endl;
+        }
+    }
+    ostringstream old_table;
+    cout.rdbuf(old_table.rdbuf());
+    um.display();
+    cout.rdbuf(saved);
+
+    ViewRenderer renderer;
+    ViewRange first_four;
+    first_four.to_height = 4;
+    ostringstream text, table;
+    ViewPage blocks = renderer.render_blocks(chain, first_four, RENDER_TEXT, text);
+    renderer.render_utxos(um, ViewRange(), RENDER_TEXT, table);
+    bool same_text = blocks.shown == 4 && !blocks.more && text.str() == old_text.str() && table.str() == old_table.str();
+    expect(same_text, "Text views should print exactly what the old displays printed");
+
+    ViewRange window;
+    window.from_height = 5;
+    window.to_height = 11;
+    window.offset = 2;
+    window.limit = 3;
+    ostringstream lines;
+    ViewPage page = renderer.render_blocks(chain, window, RENDER_JSON, lines);
+    istringstream in(lines.str());
+    string line;
+    int height = 7;
+    bool same_json = page.shown == 3 && page.more;
+    while (getline(in, line)) {
+        Json parsed;
+        string error;
+        same_json = same_json && Json::parse(line, parsed, error) && parsed.dump() == block_to_json(chain[height - 1]).dump();
+        height++;
+    }
+    ViewRange pruned_only;
+    pruned_only.to_height = 1;
+    ostringstream pruned_line;
+    renderer.render_blocks(chain, pruned_only, RENDER_JSON, pruned_line);
+    same_json = same_json && height == 10 && pruned_line.str() == block_to_json(chain[0]).dump() + "\n";
+    expect(same_json, "JSON lines should match block_to_json for heights 7-9");
+
+    ViewRange carol;
+    carol.owner = "Carol";
+    carol.offset = 10;
+    carol.limit = 5;
+    ostringstream carol_lines;
+    ViewPage last = renderer.render_utxos(um, carol, RENDER_JSON, carol_lines);
+    vector<UTXO> owned = um.get_utxos_for_owner("Carol");
+    string expected_carol;
+    for (size_t i = 10; i < owned.size(); ++i) expected_carol += utxo_to_json(owned[i]).dump() + "\n";
+    bool filtered = owned.size() == 12 && last.shown == 2 && !last.more && carol_lines.str() == expected_carol;
+    expect(filtered, "Owner filter with offset and limit should give the last page of Carol's UTXOs");
+
+    for (int i = 0; i < 3000; ++i) um.add_utxo("bulk", i, 1.0, "Owner" + to_string(i % 9));
+    ViewRenderer big, small(256);
+    ostringstream one, many;
+    size_t big_writes = big.writes;
+    big.render_utxos(um, ViewRange(), RENDER_TEXT, one);
+    small.render_utxos(um, ViewRange(), RENDER_TEXT, many);
+    bool buffered = big.writes - big_writes == (one.str().size() + (1 << 16) - 1) / (1 << 16) && small.writes > 100 && one.str() == many.str();
+    expect(buffered, "Views should leave in 64 KB writes and read the same at any threshold");
+    cout << endl;
+    return same_text && same_json && filtered && buffered;
+}
+
+/*
+Test 34: Reorg Keeps the Halving Schedule
+- A branch block paying more than the scheduled reward for its height is refused
+- After switching to a longer branch, the next mined block pays the reward the schedule
+  gives its height, and the supply audit still passes
+*/
+template<typename Sim>
+static bool test_reorg_halving() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 34: Reorg Keeps the Halving Schedule" << endl;
+    Sim sim(0.01, 6.25, 5, 2, 1 << 20, 3600, 34);
+    sim.create_transaction("Alice", "Bob", 1.0);
+    sim.mine_next_block("Miner");
+    sim.create_transaction("Bob", "Charlie", 1.0);
+    sim.mine_next_block("Miner");
+
+    //empty blocks from a rival miner at heights 2-4, each paying only its coinbase
+    auto branch_of = [](double first_reward) {
+        vector<Block> branch;
+        double rewards[] = {first_reward, 3.125, 3.125};
+        for (int h = 2; h <= 4; ++h) {
+            Block block = {h, "Rival", {}, 0, rewards[h - 2], ""};
+            branch.push_back(block);
+        }
+        return branch;
+    };
+    auto greedy = sim.reorganize(1, branch_of(50.0));
+    bool refused = !greedy.first && greedy.second.find("schedule") != string::npos && sim.audit_supply().first;
+    expect(refused, "A branch block paying more than the schedule should be refused: " + greedy.second);
+
+    auto switched = sim.reorganize(1, branch_of(6.25));
+    sim.create_transaction("Charlie", "David", 1.0);
+    Block next = sim.mine_next_block("Miner");
+    auto audit = sim.audit_supply();
+    bool scheduled = switched.first && next.block_height == 5 && fabs(next.block_reward - 1.5625) < EPS && audit.first;
+    expect(scheduled, "The block after the reorg should pay the scheduled 1.5625 BTC: " + audit.second);
+    cout << endl;
+    return refused && scheduled;
+}
+
+/*
+Test 35: Cryptographic Known Answers
+- SHA-512("abc") from FIPS 180-2
+- Ed25519 RFC 8032 section 7.1 TEST 1 (empty message) and TEST 2 (one byte): public key
+  from the seed, signature, verification, and rejection of a flipped message bit
+*/
+static bool test_crypto_vectors() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 35: Cryptographic Known Answers" << endl;
+    auto unhex = [](const string& hex) {
+        string out;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2) out += (char)stoi(hex.substr(i, 2), nullptr, 16);
+        return out;
+    };
+    crypto::Digest abc = crypto::sha512("abc");
+    bool sha = crypto::to_hex(abc.data(), abc.size()) ==
+        "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f";
+    expect(sha, "SHA-512(\"abc\") should match FIPS 180-2");
+
+    struct Vector { const char* seed; const char* pk; const char* msg; const char* sig; };
+    const Vector vectors[] = {
+        {"9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60",
+         "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a", "",
+         "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b"},
+        {"4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb",
+         "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c", "72",
+         "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00"},
+    };
+    bool ed25519 = true;
+    for (const auto& v : vectors) {
+        string seed = unhex(v.seed), msg = unhex(v.msg);
+        crypto::PublicKey pk;
+        crypto::SecretKey sk;
+        crypto::keypair_from_seed((const uint8_t*)seed.data(), pk, sk);
+        crypto::Signature sig = crypto::sign((const uint8_t*)msg.data(), msg.size(), sk);
+        string altered = msg.empty() ? string(1, '\x01') : msg;
+        if (!msg.empty()) altered[0] ^= 1;
+        ed25519 = ed25519 && crypto::to_hex(pk.data(), pk.size()) == v.pk && crypto::to_hex(sig.data(), sig.size()) == v.sig
+            && crypto::verify((const uint8_t*)msg.data(), msg.size(), sig, pk)
+            && !crypto::verify((const uint8_t*)altered.data(), altered.size(), sig, pk);
+    }
+    expect(ed25519, "Ed25519 should reproduce the RFC 8032 TEST 1 and TEST 2 keys and signatures");
+    cout << endl;
+    return sha && ed25519;
+}
+
+/*
+Test 36: UTXO Cache as a UTXO Set
+- The mempool and mine_block run on a disk-backed cache as on the in-memory set, and both
+  end with the same set hash, balances and per-owner UTXOs
+- A cache opened on the store afterwards starts from the same set hash and supply
+- Table growth does not count the copied records as writes
+- Adding an outpoint that is only on disk overwrites it as UTXOManager does, and spending
+  it before a flush erases the stored copy; a rolled-back overwrite restores the old one
+- A write the store rejects (file size limit reached) leaves the entry dirty and cached,
+  and the next flush writes it
+*/
+static bool test_utxo_cache_interface() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 36: UTXO Cache as a UTXO Set" << endl;
+    const string path = "utxo_cache_set_test";
+    UTXOManager um;
+    bool same_chain = false, reopened = false, overwrite = false, counted = false, retried = false;
+    {
+        UTXODiskStore store;
+        store.open(path, 16);
+        UTXOCache cache(store, 2);
+        for (int i = 0; i < 4; ++i) {
+            um.add_utxo("genesis", i, 10.0 * (i + 1), "Owner" + to_string(i));
+            cache.add_utxo("genesis", i, 10.0 * (i + 1), "Owner" + to_string(i));
+        }
+        cache.flush();
+        Mempool mem_pool(10), disk_pool(10);
+        for (int i = 0; i < 3; ++i) {
+            Transaction tx;
+            tx.tx_id = make_tx_id("cache_set");
+            tx.inputs.push_back({"genesis", i, "Owner" + to_string(i)});
+            tx.outputs.push_back({4.0, "Shop"});
+            tx.outputs.push_back({10.0 * (i + 1) - 5.0, "Owner" + to_string(i)});
+            mem_pool.add_transaction(tx, um);
+            disk_pool.add_transaction(tx, cache);
+        }
+        Block a = mine_block("Miner", mem_pool, um, 1, 6.25);
+        Block b = mine_block("Miner", disk_pool, cache, 1, 6.25);
+        cache.flush();
+        same_chain = a.utxo_hash == b.utxo_hash && cache.state_hash() == um.state_hash()
+            && fabs(cache.get_balance("Shop") - 12.0) < EPS && fabs(cache.get_balance("Miner") - um.get_balance("Miner")) < EPS
+            && cache.get_utxos_for_owner("Owner2").size() == 1 && cache.get_utxos_for_owner("Owner3").size() == 1
+            && !cache.exists("genesis", 0) && store.size() == um.utxo_set.size();
+        expect(same_chain, "Mining on the cache should match mining on the in-memory set");
+    }
+    {
+        UTXODiskStore store;
+        store.open(path);
+        UTXOCache cache(store);
+        reopened = cache.state_hash() == um.state_hash() && fabs(cache.rich_list.total_supply() - um.rich_list.total_supply()) < EPS;
+        expect(reopened, "A reopened cache should start from the stored set's hash and supply");
+    }
+    {
+        UTXODiskStore store;
+        store.open(path);
+        UTXOCache cache(store);
+        UTXOManager copy = um;
+        //genesis:3 is on disk but not cached
+        cache.checkpoint();
+        cache.add_utxo("genesis", 3, 1.0, "Other");
+        cache.rollback();
+        bool restored = cache.state_hash() == copy.state_hash() && fabs(cache.get_balance("Owner3") - copy.get_balance("Owner3")) < EPS;
+        copy.add_utxo("genesis", 3, 99.0, "Other");
+        cache.add_utxo("genesis", 3, 99.0, "Other");
+        bool overwritten = cache.state_hash() == copy.state_hash() && fabs(cache.get_balance("Owner3") - copy.get_balance("Owner3")) < EPS
+            && fabs(cache.rich_list.total_supply() - copy.rich_list.total_supply()) < EPS;
+        copy.remove_utxo("genesis", 3);
+        cache.remove_utxo("genesis", 3);
+        cache.flush();
+        UTXO stored;
+        overwrite = restored && overwritten && cache.state_hash() == copy.state_hash() && !store.get("genesis", 3, stored);
+        expect(overwrite, "Adding a stored outpoint should overwrite it, and spending it should erase it from disk");
+    }
+    remove((path + ".idx").c_str());
+    remove((path + ".dat").c_str());
+    {
+        UTXODiskStore store;
+        store.open(path, 16);
+        UTXOCache cache(store, 8);
+        for (int i = 0; i < 100; ++i)
+            cache.add_utxo("grow", i, 1.0, "Owner");
+        cache.flush();
+        counted = store.size() == 100 && store.writes == 100;
+        expect(counted, "Rebuilding the table on growth should not count as writes");
+    }
+    remove((path + ".idx").c_str());
+    remove((path + ".dat").c_str());
+    {
+        UTXODiskStore store;
+        store.open(path, 16);
+        UTXOCache cache(store, 1);
+        cache.add_utxo("limit", 0, 1.0, "Owner");
+        cache.flush();
+        cache.add_utxo("limit", 1, 2.0, "Owner");
+        //stop the data file growing past its current size so the next put fails
+        struct stat st;
+        struct rlimit old_limit, limit;
+        stat((path + ".dat").c_str(), &st);
+        getrlimit(RLIMIT_FSIZE, &old_limit);
+        limit = old_limit;
+        limit.rlim_cur = st.st_size;
+        auto old_handler = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        bool failed = !cache.flush();
+        setrlimit(RLIMIT_FSIZE, &old_limit);
+        signal(SIGXFSZ, old_handler);
+        UTXO stored;
+        bool kept = !store.get("limit", 1, stored) && cache.exists("limit", 1) && cache.dirty() == 1;
+        retried = failed && kept && cache.flush() && store.get("limit", 1, stored) && stored.amount == 2.0 && cache.dirty() == 0;
+        expect(retried, "A failed write should stay dirty in the cache until a later flush writes it");
+    }
+    remove((path + ".idx").c_str());
+    remove((path + ".dat").c_str());
+    cout << endl;
+    return same_chain && reopened && overwrite && counted && retried;
+}
+
+/*
+Test 37: Replay Through Mempool Eviction
+- A recorded run fills the memory budget, so the cheapest transaction is evicted and a
+  later cheap one falls below the raised minimum fee rate
+- The log replays to the same state: eviction and the rolling minimum follow the recorded clock
+(the simulator type is a template parameter because this file is included before it is defined)
+*/
+template<typename Sim>
+static bool test_replay_eviction() {
+    cout<<"\n=======================\n";
+    cout << "Running Test 37: Replay Through Mempool Eviction" << endl;
+    auto mempool_field = [](Sim& sim, const string& field) {
+        RpcServer server;
+        sim.register_rpc_methods(server);
+        string reply = server.handle_line("{\"jsonrpc\":\"2.0\",\"method\":\"get_mempool\",\"id\":1}");
+        Json doc;
+        string error;
+        const Json* value = Json::parse(reply, doc, error) && doc.get("result") ? doc.get("result")->get(field) : nullptr;
+        return value && value->is_number() ? (size_t)value->number : 0;
+    };
+    size_t one_tx;
+    {
+        Sim probe(0.01, 6.25, 50, 2, 1 << 20, 3600, 37);
+        probe.create_transaction("Alice", "Bob", 10);
+        one_tx = mempool_field(probe, "bytes");
+    }
+
+    string path = "/tmp/sim_eviction_" + to_string(getpid()) + ".log";
+    Sim recorded(0.01, 6.25, 50, 2, one_tx * 2 + one_tx / 2, 3600, 37);
+    bool opened = recorded.start_recording(path).first;
+    bool first = recorded.create_transaction("Alice", "Bob", 10).first;
+    bool cheap = recorded.create_transaction("Bob", "Charlie", 1).first;
+    bool rich = recorded.create_transaction("Charlie", "David", 15).first;
+    auto below = recorded.create_transaction("David", "Eve", 0.5);
+    recorded.stop_recording();
+    bool evicted = opened && one_tx > 0 && first && cheap && rich && mempool_field(recorded, "size") == 2
+        && !below.first && below.second.find("below mempool minimum") != string::npos;
+    expect(evicted, "The budget should evict the cheapest transaction and raise the minimum fee rate");
+
+    ReplayStats stats = {};
+    auto replayed = Sim::replay(path, &stats);
+    remove(path.c_str());
+    bool matches = replayed.first && stats.events == 6 && stats.state_hash == recorded.state_hash();
+    expect(matches, "The run with evictions should replay to the recorded state: " + replayed.second);
+    cout << endl;
+    return evicted && matches;
+}
+
 /*
 Run all tests and print a summary.
 */